@@ -0,0 +1,42 @@
+#ifndef BOOT_STATUS_H
+#define BOOT_STATUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * Boot milestones as readiness events.
+ *
+ * The display, camera and USB come up concurrently; each marks its stage
+ * once and whoever depends on it waits on the event instead of sleeping a
+ * fixed time. The time of every stage is kept and logged when it is
+ * reached, counted from application start (esp_timer), so ROM and
+ * bootloader time are not included.
+ */
+
+typedef enum {
+    BOOT_STAGE_DISPLAY = 0,     // LCD running and the UI built
+    BOOT_STAGE_FIRST_FRAME,     // First good capture from the sensor
+    BOOT_STAGE_CAMERA,          // Sensor idle after boot work, free for the pipeline
+    BOOT_STAGE_USB_MOUNTED,     // Host enumerated and configured the device
+    BOOT_STAGE_COUNT,
+} boot_stage_t;
+
+#define BOOT_STAGE_BIT(stage)   (1u << (stage))
+
+void boot_status_init(void);
+
+// Record the stage (first call only) and wake its waiters
+void boot_status_mark(boot_stage_t stage);
+
+// Wait until every stage in the BOOT_STAGE_BIT() mask is reached
+bool boot_status_wait(uint32_t stages, TickType_t wait);
+
+// Milliseconds from application start to the stage, -1 if not reached yet
+int32_t boot_status_ms(boot_stage_t stage);
+
+// One line per stage
+void boot_status_print(void);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef CAMERA_CTRL_H
+#define CAMERA_CTRL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+esp_err_t camera_ctrl_init(void);
+
+// True when the sensor delivers JPEG itself (CONFIG_WEBCAM_CHAN_SENSOR_JPEG)
+bool camera_ctrl_sensor_jpeg(void);
+
+// The sensor can output exactly this size (an esp32-camera framesize_t
+// within the sensor's maximum)
+bool camera_ctrl_frame_size_supported(uint16_t width, uint16_t height);
+
+/**
+ * Reconfigure the sensor output and frame buffers for the given size.
+ * Sizes the sensor cannot produce fail with ESP_ERR_NOT_SUPPORTED and
+ * leave the current configuration in place. The size actually produced is
+ * written back to *width and *height. With raw set the sensor delivers
+ * RGB565 even in sensor JPEG mode (uncompressed streaming).
+ */
+esp_err_t camera_ctrl_set_frame_size(uint16_t *width, uint16_t *height, bool raw);
+
+/**
+ * Switch between CAMERA_GRAB_LATEST (the driver keeps only the newest
+ * frame, one more frame buffer) and CAMERA_GRAB_WHEN_EMPTY (frames queue
+ * up until taken). Re-initialises the camera when the mode changes.
+ */
+esp_err_t camera_ctrl_set_grab_latest(bool latest);
+
+/**
+ * Apply a UVC Camera Terminal or Processing Unit control through the
+ * sensor ISP. Returns ESP_ERR_NOT_SUPPORTED when the sensor has no matching
+ * register so the caller can process it in software instead. Manual
+ * exposure, gain and white balance values are kept while the matching auto
+ * mode is on and take effect when it is switched off. Accepted values
+ * survive sensor re-inits. Does SCCB writes, so it must not run in the USB
+ * control-transfer context.
+ */
+esp_err_t camera_ctrl_set_control(uint8_t entity, uint8_t selector, int32_t value);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CAMERA_PREVIEW_H
+#define CAMERA_PREVIEW_H
+
+#include "esp_camera.h"
+#include "lvgl.h"
+
+/**
+ * Live camera preview on the LCD, sharing the encoder's RGB565 capture.
+ *
+ * The encoder task shares each RGB565 frame before encoding it. When the
+ * preview is ready for a new picture it takes a reference to the camera
+ * frame and points an LVGL image at fb->buf, with no copy. The frame goes
+ * back to the camera driver only once both the encoder and the display
+ * have released it. While the display has not picked up the previous
+ * frame yet, frames are not shared at all, so the preview never holds the
+ * stream back.
+ *
+ * CONFIG_WEBCAM_CHAN_PREVIEW selects off, full screen (over the avatar) or
+ * a downscaled picture-in-picture window next to the face.
+ */
+
+typedef struct camera_preview_ref camera_preview_ref_t;
+
+// Create the preview image; call with the display lock held
+void camera_preview_init(lv_obj_t *parent);
+
+/**
+ * Encoder task: offer a frame to the preview. Returns a reference to hand
+ * to camera_preview_release() instead of calling esp_camera_fb_return(),
+ * or NULL when the preview did not take the frame.
+ */
+camera_preview_ref_t *camera_preview_share(camera_fb_t *fb);
+void camera_preview_release(camera_preview_ref_t *ref);
+
+// Encoder task: hide the preview and give every held frame back to the
+// driver (stream stop, sensor re-init)
+void camera_preview_flush(void);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef CPU_LOAD_H
+#define CPU_LOAD_H
+
+#include <stdint.h>
+
+#define CPU_LOAD_CORE_COUNT  2
+
+/**
+ * Per-core CPU load since the previous call, in 0.1 % units.
+ * Derived from the FreeRTOS idle task run time counters.
+ */
+void cpu_load_sample(uint32_t load_x10[CPU_LOAD_CORE_COUNT]);
+
+#endif
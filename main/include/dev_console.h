@@ -0,0 +1,23 @@
+#ifndef DEV_CONSOLE_H
+#define DEV_CONSOLE_H
+
+#include "esp_err.h"
+
+/**
+ * Start a REPL on the UART console with diagnostic commands:
+ *   trace          per-stage p50/p99/max over the recent frames
+ *   trace raw      the recent frames' timestamps as CSV
+ *   trace clear    forget the recorded frames
+ *   face           avatar pixels redrawn per expression change
+ *   governor       toggle the display refresh governor
+ *   latency        low-latency / throughput capture mode, dropped and stale counts
+ *   usb            streaming endpoint mode and bandwidth-limited frame rates
+ *   strip          JPEG encode time and stall cycles, PSRAM vs. GDMA strips
+ *   dual           JPEG encode time on one core vs. two restart bands
+ *   mem            memory arena budget table and remaining heap
+ *   boot           time to display, first frame, camera and USB enumeration
+ *   framedump      raw RGB565 frames for the host benchmark corpus
+ */
+esp_err_t dev_console_start(void);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef DISPLAY_GOVERNOR_H
+#define DISPLAY_GOVERNOR_H
+
+#include <stdbool.h>
+
+/**
+ * Keeps the LCD out of the video pipeline's way while streaming.
+ *
+ * The LVGL refresh period is stretched to
+ * CONFIG_WEBCAM_CHAN_DISPLAY_STREAM_REFR_MS while a stream is running, and
+ * the encoder task holds the LVGL lock while it encodes, so LVGL renders
+ * and flushes only in the gaps between frames instead of competing with
+ * the encoder for PSRAM bandwidth and CPU. The default period
+ * (LV_DEF_REFR_PERIOD) comes back when the stream stops.
+ */
+
+// Apply the refresh period for the streaming state; call with the display lock held
+void display_governor_set_streaming(bool streaming);
+
+// Turn the governor on or off at runtime (for A/B measurements); takes the display lock
+void display_governor_enable(bool enable);
+bool display_governor_enabled(void);
+
+// Bracket one frame's encode on the encoder task
+bool display_governor_encode_begin(void);
+void display_governor_encode_end(bool held);
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+#include "cpu_load.h"
+#include "frame_trace.h"
+
+// Number of in-flight frames: one on USB, one being encoded, one ready
+#define FRAME_PIPELINE_SLOT_COUNT   3
+
+// Encoder task placement (the UVC and TinyUSB tasks are not pinned,
+// CONFIG_UVC_*_TASK_CORE = -1)
+#define FRAME_PIPELINE_TASK_CORE    1
+#define FRAME_PIPELINE_TASK_PRIO    4
+#define FRAME_PIPELINE_TASK_STACK   8192
+
+// Interval of the periodic stats log while streaming, and of the telemetry
+// refresh while idle
+#define FRAME_PIPELINE_STATS_PERIOD_US  (5 * 1000 * 1000)
+
+typedef enum {
+    FRAME_PIPELINE_SW_JPEG = 0,     // RGB565 capture + software JPEG encode
+    FRAME_PIPELINE_SENSOR_JPEG,     // Sensor JPEG passed through zero-copy
+} frame_pipeline_mode_t;
+
+typedef enum {
+    FRAME_FORMAT_MJPEG = 0,
+    FRAME_FORMAT_YUY2,              // Uncompressed, converted from RGB565
+} frame_format_t;
+
+typedef enum {
+    FRAME_LATENCY_THROUGHPUT = 0,   // Queue captures, never skip a frame
+    FRAME_LATENCY_LOW,              // Newest capture only; stale ones skipped
+} frame_latency_mode_t;
+
+typedef enum {
+    FRAME_SLOT_FREE = 0,
+    FRAME_SLOT_ENCODING,
+    FRAME_SLOT_READY,
+    FRAME_SLOT_IN_USB,
+} frame_slot_state_t;
+
+typedef enum {
+    FRAME_LIVE_NONE = 0,    // Handed to USB once complete
+    FRAME_LIVE_ENCODING,    // Sliced: handed to USB while live_len grows
+    FRAME_LIVE_DONE,
+    FRAME_LIVE_FAILED,      // The encoder gave up; what was sent is void
+} frame_live_t;
+
+typedef struct {
+    frame_slot_state_t state;
+    uint32_t seq;
+    uint8_t *buf;           // Preallocated output (software JPEG / YUY2)
+    size_t capacity;
+    camera_fb_t *fb;        // Held camera frame (SENSOR_JPEG mode)
+    uint8_t *data;          // Frame data handed to USB
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+    struct timeval timestamp;
+    frame_trace_t trace;    // Stage timestamps, pushed when the slot is freed
+    volatile frame_live_t live;
+    volatile uint32_t live_len;     // Final bytes at data so far (sliced)
+} frame_slot_t;
+
+typedef struct {
+    uint32_t captured;
+    uint32_t encoded;
+    uint32_t sent;
+    uint32_t dropped;       // Finished frames superseded before USB took them
+    uint32_t stale;         // Captures skipped as too old (low-latency mode)
+    uint32_t encode_failed;
+    uint32_t queue_depth;
+    uint32_t queue_depth_max;
+    uint32_t capture_fps_x10;
+    uint32_t encode_fps_x10;
+    uint32_t usb_fps_x10;
+    uint32_t encode_us_avg;
+    uint32_t heap_allocs_per_frame_x100;   // 0 without CONFIG_WEBCAM_CHAN_HEAP_ALLOC_COUNT
+    uint32_t cpu_load_x10[CPU_LOAD_CORE_COUNT];
+    // Adaptive JPEG quality (software encoding only)
+    uint32_t jpeg_quality;
+    uint32_t jpeg_target_bytes;
+    uint32_t jpeg_bytes_avg;
+    uint32_t target_fps;
+} frame_pipeline_stats_t;
+
+// Start the encoder task; it captures nothing until frame_pipeline_set_ready()
+esp_err_t frame_pipeline_init(void);
+// The camera delivers frames and the display is up: streams may capture.
+// A stream started before this waits for it
+void frame_pipeline_set_ready(frame_pipeline_mode_t mode);
+bool frame_pipeline_ready(void);
+// Carve the fixed per-slot output buffers from the PSRAM arena (once,
+// before streaming); boot aborts when they do not fit
+void frame_pipeline_alloc_buffers(size_t buf_size);
+// Begin streaming at the host-negotiated format, frame size and rate; the
+// stream stops, with no frame sent, if the sensor cannot switch to the size
+void frame_pipeline_start(frame_format_t format, uint16_t width, uint16_t height, uint32_t fps);
+void frame_pipeline_stop(void);
+// Wake the idle encoder task so control changes reach the sensor without
+// waiting for the next stream; while streaming they apply per frame
+void frame_pipeline_wake(void);
+// True between start and stop, i.e. while the encoder task owns the camera
+bool frame_pipeline_streaming(void);
+// Take the camera from the idle encoder task (console tools). Fails while
+// streaming; a stream started before frame_pipeline_return_camera() waits
+bool frame_pipeline_borrow_camera(TickType_t wait);
+void frame_pipeline_return_camera(void);
+
+/**
+ * Latency mode, applied by the encoder task before its next capture.
+ * FRAME_LATENCY_LOW switches the camera to CAMERA_GRAB_LATEST, skips
+ * captures older than CONFIG_WEBCAM_CHAN_STALE_FRAME_MS and limits
+ * frame_pipeline_acquire() to one frame interval.
+ */
+void frame_pipeline_set_latency_mode(frame_latency_mode_t mode);
+frame_latency_mode_t frame_pipeline_latency_mode(void);
+
+// Take the newest finished frame; older finished frames are dropped. In
+// low-latency mode the wait is capped at one frame interval. With
+// CONFIG_WEBCAM_CHAN_SLICED_JPEG this may be a frame still being encoded
+// (live != FRAME_LIVE_NONE), to be sent as frame_pipeline_live_progress()
+// reports it
+frame_slot_t *frame_pipeline_acquire(TickType_t wait);
+void frame_pipeline_release(frame_slot_t *slot);
+
+// Bytes of a sliced frame that are final so far, and its state
+uint32_t frame_pipeline_live_progress(const frame_slot_t *slot, frame_live_t *state);
+// listener is called on the encoder task whenever a sliced frame grows or
+// ends; abort from frame_pipeline_stop(), before the slots are freed
+void frame_pipeline_set_slice_listener(void (*listener)(void), void (*abort)(void));
+
+void frame_pipeline_get_stats(frame_pipeline_stats_t *out);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_timer.h"
+
+/*
+ * Per-frame stage timestamps, kept in a lock-free ring of the most recent
+ * frames. Stamps are esp_timer microseconds truncated to 32 bits, so only
+ * differences between them are meaningful.
+ */
+
+// Ring depth (frames); about 8 s of history at 30 fps
+#define FRAME_TRACE_DEPTH  256
+
+typedef enum {
+    FRAME_TRACE_SENSOR = 0,     // Sensor capture time (fb->timestamp)
+    FRAME_TRACE_FB_GET,         // esp_camera_fb_get() returned
+    FRAME_TRACE_ENC_START,
+    FRAME_TRACE_ENC_END,
+    FRAME_TRACE_HANDOFF,        // Handed to USB as uvc_frame
+    FRAME_TRACE_RETURN,         // fb_return_cb
+    FRAME_TRACE_STAGE_COUNT,
+} frame_trace_stage_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t t[FRAME_TRACE_STAGE_COUNT];
+    uint32_t bytes;
+    bool dropped;               // Superseded before reaching USB
+} frame_trace_t;
+
+static inline void frame_trace_stamp(frame_trace_t *trace, frame_trace_stage_t stage)
+{
+    trace->t[stage] = (uint32_t)esp_timer_get_time();
+}
+
+// Append a finished (sent or dropped) frame; safe from any task
+void frame_trace_push(const frame_trace_t *trace);
+
+// Total frames pushed as dropped since boot
+uint32_t frame_trace_dropped(void);
+
+// Per-stage p50 / p99 / max over the frames currently in the ring
+void frame_trace_print_summary(void);
+// One line per frame in the ring, oldest first
+void frame_trace_print_raw(void);
+void frame_trace_clear(void);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef IMAGE_ADJUST_H
+#define IMAGE_ADJUST_H
+
+/**
+ * Applies the UVC Camera Terminal and Processing Unit controls to the
+ * video.
+ *
+ * Controls the sensor ISP supports are written to it (no per-frame cost
+ * at all). Brightness, Contrast, Hue and Saturation (128 = neutral) fall
+ * back to the encoders' RGB -> YCbCr step, so a change only rebuilds a few
+ * tables; other controls without a sensor register have no effect.
+ */
+
+// Push changed controls to the sensor and the encoder tables; a no-op
+// unless a control changed. Runs on the encoder task, which also owns
+// sensor re-init, so SCCB writes never block the USB stack
+void image_adjust_apply_if_changed(void);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef JPEG_ENCODE_H
+#define JPEG_ENCODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "jpeg_enc.h"
+
+#define JPEG_ENCODE_DEFAULT_QUALITY  80
+
+// In-tree encoder cost since the last reset (successful frames only)
+typedef struct {
+    uint32_t frames;
+    uint32_t strip_frames;      // Staged through the SRAM strips by GDMA
+    uint32_t dual_frames;       // Split into two restart bands, one per core
+    uint32_t encode_us_avg;
+    uint32_t stall_cycles_avg;  // Data-stall cycles, the PSRAM cache-miss proxy
+} jpeg_encode_profile_t;
+
+// Prepare the configured backend and verify its SIMD kernels (once, at boot)
+void jpeg_encode_init(void);
+// Carve the dual-core bottom band's output for frames up to frame_bytes
+// from the PSRAM arena (once, before streaming); a no-op without the band
+// task, and boot aborts when it does not fit
+void jpeg_encode_alloc_buffers(size_t frame_bytes);
+
+/**
+ * Encode a camera frame into a caller-supplied buffer.
+ *
+ * Returns false without touching anything past buf_size when the encoded
+ * frame does not fit; *out_len is then 0.
+ */
+bool jpeg_encode_into(camera_fb_t *fb, uint8_t quality,
+                      uint8_t *buf, size_t buf_size, size_t *out_len);
+
+// Progress of a sliced encode: the first `bytes` of the output are final
+typedef void (*jpeg_encode_slice_cb_t)(size_t bytes, void *arg);
+
+/**
+ * jpeg_encode_into() that reports progress once the headers are written and
+ * after every MCU row, so the start of the frame can be sent while the rest
+ * is still being encoded. Only the in-tree encoder slices RGB565 frames;
+ * anything else is encoded whole and on_slice is never called.
+ */
+bool jpeg_encode_sliced_into(camera_fb_t *fb, uint8_t quality, uint8_t *buf, size_t buf_size,
+                             size_t *out_len, jpeg_encode_slice_cb_t on_slice, void *arg);
+
+// Picture adjustment for the in-tree encoder; NULL restores the identity
+void jpeg_encode_set_adjust(const jpeg_enc_adjust_t *adjust);
+
+/**
+ * Stage frames through internal SRAM strips (CONFIG_WEBCAM_CHAN_JPEG_STRIP_DMA)
+ * or read them from PSRAM, for A/B timing. Resets the profile.
+ */
+void jpeg_encode_use_strips(bool enable);
+// True when the strips and a GDMA channel were set up at init
+bool jpeg_encode_strips_available(void);
+bool jpeg_encode_strips_enabled(void);
+
+void jpeg_encode_get_profile(jpeg_encode_profile_t *out);
+void jpeg_encode_reset_profile(void);
+
+/**
+ * Encode RGB565 frames as two restart-interval bands on both cores
+ * (CONFIG_WEBCAM_CHAN_JPEG_DUAL_CORE) or on the encoder task alone, for
+ * A/B timing. Takes precedence over the strips. Resets the profile.
+ */
+void jpeg_encode_use_dual_core(bool enable);
+// True when the band task was started at init
+bool jpeg_encode_dual_core_available(void);
+bool jpeg_encode_dual_core_enabled(void);
+
+// Short name of the active backend, for logs
+const char *jpeg_encode_backend_name(void);
+
+// Time every available backend on one RGB565 frame, and the in-tree one
+// with and without strip staging and on one or both cores, and log the
+// results. Call it from the encoder's core (1): on core 0 the two bands
+// would share a core and are not timed
+void jpeg_encode_benchmark(camera_fb_t *fb);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef JPEG_RATE_CTRL_H
+#define JPEG_RATE_CTRL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Closed-loop JPEG quality controller. After every frame the quality for
+ * the next one is adjusted from the compressed size and the encode time,
+ * aiming for a per-frame byte budget at the negotiated frame rate.
+ *
+ * Only the encoder task calls into it; the counters are copied into the
+ * pipeline stats.
+ */
+
+typedef struct {
+    uint8_t quality;            // Quality for the next frame
+    uint32_t target_bytes;      // Effective per-frame budget
+    uint32_t target_fps;
+    uint32_t bytes_avg;         // Smoothed compressed size
+    uint32_t encode_us_avg;     // Smoothed encode time
+} jpeg_rate_ctrl_state_t;
+
+/**
+ * Restart the controller for a new stream. The budget is the configured
+ * one, limited by buf_capacity and by what the endpoint drains per frame.
+ */
+void jpeg_rate_ctrl_reset(size_t buf_capacity, uint32_t fps);
+
+uint8_t jpeg_rate_ctrl_quality(void);
+
+// Feed back one frame; ok is false when the frame did not fit its buffer
+void jpeg_rate_ctrl_update(bool ok, size_t bytes, uint32_t encode_us);
+
+void jpeg_rate_ctrl_get_state(jpeg_rate_ctrl_state_t *out);
+
+#endif
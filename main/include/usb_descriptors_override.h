@@ -0,0 +1,74 @@
+#ifndef USB_DESCRIPTORS_OVERRIDE_H
+#define USB_DESCRIPTORS_OVERRIDE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define USB_FORMAT_INDEX_MJPEG  1
+#define USB_FORMAT_INDEX_YUY2   2
+
+// Uncompressed frame sizes that fit full-speed streaming bandwidth
+#define USB_YUY2_FRAME_1_WIDTH   160
+#define USB_YUY2_FRAME_1_HEIGHT  120
+#define USB_YUY2_FRAME_2_WIDTH   320
+#define USB_YUY2_FRAME_2_HEIGHT  240
+
+// Largest frame the CoreS3's GC0308 outputs; no advertised size may exceed it
+#define USB_SENSOR_MAX_WIDTH     640
+#define USB_SENSOR_MAX_HEIGHT    480
+
+#define USB_YUY2_MAX_FRAME_BYTES  (USB_YUY2_FRAME_2_WIDTH * USB_YUY2_FRAME_2_HEIGHT * 2)
+
+/**
+ * True when the host's last commit selected the YUY2 format; fills in the
+ * committed frame size and rate. usb_device_uvc only knows the MJPEG frame
+ * table, so start_cb arguments are not valid for YUY2.
+ */
+bool usb_desc_committed_yuy2(uint16_t *width, uint16_t *height, uint32_t *fps);
+
+// Accept stream commits; until then they fail with "not ready"
+void usb_desc_set_stream_ready(bool ready);
+
+// Payload bytes the streaming endpoint can drain within one frame interval
+uint32_t usb_desc_stream_bytes_per_frame(uint32_t fps);
+// Same, per second; for bulk this is the idle-bus ceiling, not a guarantee
+uint32_t usb_desc_stream_bytes_per_second(void);
+
+// "isochronous" or "bulk" (CONFIG_UVC_MODE_BULK_CAM1) and its packet size
+const char *usb_desc_stream_mode(void);
+uint16_t usb_desc_stream_ep_size(void);
+
+/**
+ * Sensor capture time (esp_timer us) of the frame about to be queued. It
+ * goes out as the payload header PTS, next to an SCR sampled when the
+ * frame's first packet is queued.
+ */
+void usb_desc_set_frame_capture_time(int64_t capture_us);
+
+// Bytes of a sliced frame that are final so far; *done once it is complete,
+// *failed when the encoder gave up on it
+typedef size_t (*usb_desc_slice_poll_t)(void *arg, bool *done, bool *failed);
+// The last byte of a sliced frame is on the wire (or the stream stopped)
+typedef void (*usb_desc_slice_done_t)(void *arg);
+
+// Start the task that queues sliced frames (CONFIG_WEBCAM_CHAN_SLICED_JPEG)
+esp_err_t usb_desc_slices_init(void);
+
+/**
+ * Send the frame about to be queued from buf as it grows, instead of the
+ * buffer usb_device_uvc passes to TinyUSB. Call from fb_get_cb. done runs
+ * on the slice task once the frame is out; the caller keeps buf until then.
+ */
+void usb_desc_stream_sliced(const uint8_t *buf, usb_desc_slice_poll_t poll,
+                            usb_desc_slice_done_t done, void *arg);
+// More bytes are final, or the frame ended: queue the next batch
+void usb_desc_slice_kick(void);
+// A sliced frame handed over but never queued (usb_device_uvc rejected
+// it) is reported done so its buffer is released
+void usb_desc_slices_drop_pending(void);
+// Streaming stopped: forget the frame without reporting it done
+void usb_desc_slices_abort(void);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef UVC_TELEMETRY_H
+#define UVC_TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "uvc_ctrl_registry.h"
+#include "frame_pipeline.h"
+
+/**
+ * Pipeline health as read-only controls of a UVC Extension Unit, so hosts
+ * can poll an unattended device (uvcdynctrl, UVCIOC_CTRL_QUERY) without a
+ * serial console or an extra USB interface. Every control is a 4-byte
+ * unsigned GET_CUR value.
+ *
+ * The frame path only does relaxed atomic adds (uvc_telemetry_record_frame);
+ * the encoder's periodic stats tick, which also runs while idle so CPU load
+ * stays current, turns them into per-window values, and
+ * GET_CUR reads those atomically from the USB task. No locks on either side.
+ */
+
+// {5c1e0a7d-3b2f-4c8e-9a41-7e6d2f0b8c35}
+#define UVC_TELEMETRY_GUID \
+    0x7d, 0x0a, 0x1e, 0x5c, 0x2f, 0x3b, 0x8e, 0x4c, \
+    0x9a, 0x41, 0x7e, 0x6d, 0x2f, 0x0b, 0x8c, 0x35
+
+// Extension Unit control selectors
+#define UVC_XU_TELEMETRY_FPS_X10            0x01    // USB frames/s over the last window, x10
+#define UVC_XU_TELEMETRY_ENCODE_US_AVG      0x02
+#define UVC_XU_TELEMETRY_ENCODE_US_MAX      0x03
+#define UVC_XU_TELEMETRY_FRAME_BYTES_AVG    0x04
+#define UVC_XU_TELEMETRY_DROPPED            0x05    // Superseded + stale frames since boot
+#define UVC_XU_TELEMETRY_FREE_INTERNAL      0x06    // Bytes
+#define UVC_XU_TELEMETRY_FREE_PSRAM         0x07    // Bytes
+#define UVC_XU_TELEMETRY_CPU0_LOAD_X10      0x08    // 0.1 % units
+#define UVC_XU_TELEMETRY_CPU1_LOAD_X10      0x09
+#define UVC_XU_TELEMETRY_CONTROL_COUNT      9
+
+// bmControls: one bit per selector, selector n -> bit n-1
+#define UVC_XU_TELEMETRY_BM_CONTROLS        ((1u << UVC_XU_TELEMETRY_CONTROL_COUNT) - 1)
+
+extern const uvc_ctrl_entry_t g_uvc_telemetry_entries[];
+extern const size_t g_uvc_telemetry_entry_count;
+
+// Encoder task, once per encoded frame
+void uvc_telemetry_record_frame(uint32_t encode_us, uint32_t bytes);
+
+// Encoder task, from the periodic stats tick (streaming or idle): close the
+// current window
+void uvc_telemetry_publish(const frame_pipeline_stats_t *stats);
+
+#endif
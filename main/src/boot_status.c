@@ -0,0 +1,75 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "boot_status.h"
+
+static const char *TAG = "boot";
+
+static const char *const s_stage_names[BOOT_STAGE_COUNT] = {
+    [BOOT_STAGE_DISPLAY] = "display ready",
+    [BOOT_STAGE_FIRST_FRAME] = "first frame",
+    [BOOT_STAGE_CAMERA] = "camera ready",
+    [BOOT_STAGE_USB_MOUNTED] = "usb enumerated",
+};
+
+static EventGroupHandle_t s_events = NULL;
+// Stage times in ms, -1 until reached
+static atomic_int s_stage_ms[BOOT_STAGE_COUNT];
+
+void boot_status_init(void)
+{
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        atomic_store(&s_stage_ms[i], -1);
+    }
+    s_events = xEventGroupCreate();
+    if (s_events == NULL) {
+        ESP_LOGE(TAG, "no memory for the boot events");
+        abort();
+    }
+}
+
+void boot_status_mark(boot_stage_t stage)
+{
+    int ms = (int)(esp_timer_get_time() / 1000);
+    int unset = -1;
+    if (!atomic_compare_exchange_strong(&s_stage_ms[stage], &unset, ms)) {
+        return;
+    }
+    xEventGroupSetBits(s_events, BOOT_STAGE_BIT(stage));
+    ESP_LOGI(TAG, "%s at %d ms", s_stage_names[stage], ms);
+
+    // The two numbers a host waits for, once both are known
+    int mounted = atomic_load(&s_stage_ms[BOOT_STAGE_USB_MOUNTED]);
+    int first = atomic_load(&s_stage_ms[BOOT_STAGE_FIRST_FRAME]);
+    if ((stage == BOOT_STAGE_USB_MOUNTED || stage == BOOT_STAGE_FIRST_FRAME) &&
+        mounted >= 0 && first >= 0) {
+        ESP_LOGI(TAG, "boot to enumeration %d ms, boot to first frame %d ms", mounted, first);
+    }
+}
+
+bool boot_status_wait(uint32_t stages, TickType_t wait)
+{
+    EventBits_t bits = xEventGroupWaitBits(s_events, stages, pdFALSE, pdTRUE, wait);
+    return (bits & stages) == stages;
+}
+
+int32_t boot_status_ms(boot_stage_t stage)
+{
+    return atomic_load(&s_stage_ms[stage]);
+}
+
+void boot_status_print(void)
+{
+    for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+        int ms = atomic_load(&s_stage_ms[i]);
+        if (ms >= 0) {
+            printf("%-15s %6d ms\n", s_stage_names[i], ms);
+        } else {
+            printf("%-15s %6s\n", s_stage_names[i], "-");
+        }
+    }
+}
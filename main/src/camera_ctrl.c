@@ -0,0 +1,349 @@
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "bsp/esp-bsp.h"
+#include "uvc_ctrl_params.h"
+#include "camera_ctrl.h"
+
+static const char *TAG = "camera";
+
+static camera_config_t s_config;
+static bool s_sensor_jpeg = false;
+
+// UVC controls the sensor ISP can take over
+typedef enum {
+    HW_CTRL_UNKNOWN = 0,
+    HW_CTRL_SUPPORTED,
+    HW_CTRL_UNSUPPORTED,
+} hw_ctrl_support_t;
+
+typedef struct {
+    uint8_t entity;
+    uint8_t selector;
+    hw_ctrl_support_t support;
+    int32_t value;              // last value accepted, -1 before the first
+} hw_ctrl_t;
+
+// Mode switches come before the manual values they gate, which is also
+// the order they are restored in after a sensor re-init
+static hw_ctrl_t s_hw_ctrls[] = {
+    { UVC_ENTITY_ID_CAMERA_TERMINAL, UVC_CT_AE_MODE_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_CAMERA_TERMINAL, UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_GAIN_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_BACKLIGHT_COMPENSATION_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_BRIGHTNESS_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_CONTRAST_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_SATURATION_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_SHARPNESS_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_GAMMA_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_WHITE_BALANCE_TEMP_AUTO_CONTROL, HW_CTRL_UNKNOWN, -1 },
+    { UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_WHITE_BALANCE_TEMP_CONTROL, HW_CTRL_UNKNOWN, -1 },
+};
+
+#define HW_CTRL_COUNT  (sizeof(s_hw_ctrls) / sizeof(s_hw_ctrls[0]))
+
+static hw_ctrl_t *find_hw_ctrl(uint8_t entity, uint8_t selector)
+{
+    for (size_t i = 0; i < HW_CTRL_COUNT; i++) {
+        if (s_hw_ctrls[i].entity == entity && s_hw_ctrls[i].selector == selector) {
+            return &s_hw_ctrls[i];
+        }
+    }
+    return NULL;
+}
+
+// Value a gating control was last set to, or its UVC default
+static int32_t hw_ctrl_value(uint8_t entity, uint8_t selector, int32_t def)
+{
+    hw_ctrl_t *ctrl = find_hw_ctrl(entity, selector);
+    return (ctrl != NULL && ctrl->value >= 0) ? ctrl->value : def;
+}
+
+// GC0308 row time at its reference 24 MHz clock: the reference
+// anti-flicker step of 150 rows (reg 0xe3 = 0x96) is one 10 ms half-period
+// of 50 Hz mains
+#define SENSOR_ROW_TIME_NS      66667
+// Longest exposure esp32-camera's set_aec_value() takes, in rows; the UVC
+// ExposureTimeAbsolute maximum (800 = 80 ms) matches it
+#define SENSOR_AEC_MAX_ROWS     1200
+
+// UVC exposure time (100 us units) to sensor rows
+static int aec_rows_from_uvc(int32_t value)
+{
+    int64_t rows = ((int64_t)value * 100000 + SENSOR_ROW_TIME_NS / 2) / SENSOR_ROW_TIME_NS;
+    return rows < 1 ? 1 : (rows > SENSOR_AEC_MAX_ROWS ? SENSOR_AEC_MAX_ROWS : (int)rows);
+}
+
+// UVC 0..255 (128 = neutral) to the sensor's -2..+2 steps
+static int level_from_uvc(int32_t value)
+{
+    int level = (int)((value - 128 + (value >= 128 ? 32 : -32)) / 64);
+    return level < -2 ? -2 : (level > 2 ? 2 : level);
+}
+
+// Colour temperature to the nearest esp32-camera white balance preset
+static int wb_mode_from_kelvin(int32_t kelvin)
+{
+    if (kelvin < 3500) {
+        return 4;   // home (incandescent)
+    } else if (kelvin < 4500) {
+        return 3;   // office (fluorescent)
+    } else if (kelvin < 6000) {
+        return 1;   // sunny
+    }
+    return 2;       // cloudy
+}
+
+#define SENSOR_CALL(s, fn, ...)  ((s)->fn ? (s)->fn((s), __VA_ARGS__) : -1)
+
+// Unsupported setters are NULL or stubs returning non-zero
+static int sensor_write_ctrl(sensor_t *s, const hw_ctrl_t *ctrl, int32_t value)
+{
+    bool ae_auto = hw_ctrl_value(UVC_ENTITY_ID_CAMERA_TERMINAL, UVC_CT_AE_MODE_CONTROL,
+                                 UVC_AE_MODE_AUTO) == UVC_AE_MODE_AUTO;
+    bool wb_auto = hw_ctrl_value(UVC_ENTITY_ID_PROCESSING_UNIT,
+                                 UVC_PU_WHITE_BALANCE_TEMP_AUTO_CONTROL, 1) != 0;
+
+    if (ctrl->entity == UVC_ENTITY_ID_CAMERA_TERMINAL) {
+        switch (ctrl->selector) {
+        case UVC_CT_AE_MODE_CONTROL:
+            if (SENSOR_CALL(s, set_exposure_ctrl, value == UVC_AE_MODE_AUTO) != 0) {
+                return -1;
+            }
+            SENSOR_CALL(s, set_gain_ctrl, value == UVC_AE_MODE_AUTO);
+            return 0;
+        case UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL:
+            // Kept for when AE is switched to manual
+            return ae_auto ? (s->set_aec_value ? 0 : -1)
+                           : SENSOR_CALL(s, set_aec_value, aec_rows_from_uvc(value));
+        default:
+            return -1;
+        }
+    }
+
+    switch (ctrl->selector) {
+    case UVC_PU_GAIN_CONTROL:
+        return ae_auto ? (s->set_agc_gain ? 0 : -1) : SENSOR_CALL(s, set_agc_gain, value);
+    case UVC_PU_BACKLIGHT_COMPENSATION_CONTROL:
+        // Off, then one or two steps above the normal AE target (0..+2)
+        return SENSOR_CALL(s, set_ae_level, value);
+    case UVC_PU_BRIGHTNESS_CONTROL:
+        return SENSOR_CALL(s, set_brightness, level_from_uvc(value));
+    case UVC_PU_CONTRAST_CONTROL:
+        return SENSOR_CALL(s, set_contrast, level_from_uvc(value));
+    case UVC_PU_SATURATION_CONTROL:
+        return SENSOR_CALL(s, set_saturation, level_from_uvc(value));
+    case UVC_PU_SHARPNESS_CONTROL:
+        return SENSOR_CALL(s, set_sharpness, level_from_uvc(value));
+    case UVC_PU_GAMMA_CONTROL:
+        // The ISP has one fixed gamma curve: 1.0 is off, anything else on
+        return SENSOR_CALL(s, set_raw_gma, value > 100);
+    case UVC_PU_WHITE_BALANCE_TEMP_AUTO_CONTROL:
+        if (SENSOR_CALL(s, set_whitebal, value != 0) != 0) {
+            return -1;
+        }
+        if (value == 0) {
+            int32_t kelvin = hw_ctrl_value(UVC_ENTITY_ID_PROCESSING_UNIT,
+                                           UVC_PU_WHITE_BALANCE_TEMP_CONTROL, 5000);
+            SENSOR_CALL(s, set_wb_mode, wb_mode_from_kelvin(kelvin));
+        } else {
+            SENSOR_CALL(s, set_wb_mode, 0);
+        }
+        return 0;
+    case UVC_PU_WHITE_BALANCE_TEMP_CONTROL:
+        return wb_auto ? (s->set_wb_mode ? 0 : -1)
+                       : SENSOR_CALL(s, set_wb_mode, wb_mode_from_kelvin(value));
+    default:
+        return -1;
+    }
+}
+
+static void replay_hw_ctrl(sensor_t *s, uint8_t entity, uint8_t selector)
+{
+    hw_ctrl_t *ctrl = find_hw_ctrl(entity, selector);
+    if (ctrl != NULL && ctrl->support == HW_CTRL_SUPPORTED && ctrl->value >= 0) {
+        sensor_write_ctrl(s, ctrl, ctrl->value);
+    }
+}
+
+static void apply_sensor_settings(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        return;
+    }
+    s->set_vflip(s, BSP_CAMERA_VFLIP);
+    s->set_hmirror(s, BSP_CAMERA_HMIRROR);
+
+    // A re-init resets the sensor registers, so restore the ISP controls
+    for (size_t i = 0; i < HW_CTRL_COUNT; i++) {
+        replay_hw_ctrl(s, s_hw_ctrls[i].entity, s_hw_ctrls[i].selector);
+    }
+}
+
+static framesize_t sensor_max_frame_size(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    camera_sensor_info_t *info = (s != NULL) ? esp_camera_sensor_get_info(&s->id) : NULL;
+    return (info != NULL) ? info->max_size : FRAMESIZE_QVGA;
+}
+
+static framesize_t find_frame_size(uint16_t width, uint16_t height)
+{
+    for (int i = 0; i < FRAMESIZE_INVALID; i++) {
+        if (resolution[i].width == width && resolution[i].height == height) {
+            return (framesize_t)i;
+        }
+    }
+    return FRAMESIZE_INVALID;
+}
+
+esp_err_t camera_ctrl_init(void)
+{
+    camera_config_t config = BSP_CAMERA_DEFAULT_CONFIG;
+
+    config.pixel_format = PIXFORMAT_RGB565;
+    config.frame_size = FRAMESIZE_QVGA;
+    config.fb_count = 2;
+#if CONFIG_WEBCAM_CHAN_PREVIEW_FULL || CONFIG_WEBCAM_CHAN_PREVIEW_PIP
+    // The LCD preview may hold two frames (shown + next) on top of these
+    config.fb_count += 2;
+#endif
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+
+    esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+#if CONFIG_WEBCAM_CHAN_SENSOR_JPEG
+    // Switch to the sensor's hardware JPEG output when it has one
+    sensor_t *probe = esp_camera_sensor_get();
+    camera_sensor_info_t *info = (probe != NULL) ? esp_camera_sensor_get_info(&probe->id) : NULL;
+    if (info != NULL && info->support_jpeg) {
+        esp_camera_deinit();
+        config.pixel_format = PIXFORMAT_JPEG;
+        config.jpeg_quality = CONFIG_WEBCAM_CHAN_SENSOR_JPEG_QUALITY;
+        // One frame on USB, one ready, one being captured
+        config.fb_count = 3;
+        err = esp_camera_init(&config);
+        if (err != ESP_OK) {
+            return err;
+        }
+        s_sensor_jpeg = true;
+    }
+#endif
+
+    s_config = config;
+    apply_sensor_settings();
+    return ESP_OK;
+}
+
+esp_err_t camera_ctrl_set_control(uint8_t entity, uint8_t selector, int32_t value)
+{
+    hw_ctrl_t *ctrl = find_hw_ctrl(entity, selector);
+    if (ctrl == NULL || ctrl->support == HW_CTRL_UNSUPPORTED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (ctrl->support == HW_CTRL_SUPPORTED && ctrl->value == value) {
+        return ESP_OK;
+    }
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sensor_write_ctrl(s, ctrl, value) != 0) {
+        if (ctrl->support == HW_CTRL_UNKNOWN) {
+            ESP_LOGI(TAG, "control %u/0x%02x not in sensor, using software", entity, selector);
+            ctrl->support = HW_CTRL_UNSUPPORTED;
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        return ESP_FAIL;
+    }
+    ctrl->support = HW_CTRL_SUPPORTED;
+    ctrl->value = value;
+
+    // Manual exposure and gain only take effect once AE is off
+    if (entity == UVC_ENTITY_ID_CAMERA_TERMINAL && selector == UVC_CT_AE_MODE_CONTROL) {
+        replay_hw_ctrl(s, UVC_ENTITY_ID_CAMERA_TERMINAL, UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL);
+        replay_hw_ctrl(s, UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_GAIN_CONTROL);
+    }
+    return ESP_OK;
+}
+
+bool camera_ctrl_sensor_jpeg(void)
+{
+    return s_sensor_jpeg;
+}
+
+static esp_err_t reinit(const camera_config_t *config)
+{
+    esp_camera_deinit();
+    esp_err_t err = esp_camera_init(config);
+    if (err != ESP_OK) {
+        // Restore the previous configuration so streaming can continue
+        esp_camera_init(&s_config);
+        apply_sensor_settings();
+        return err;
+    }
+    s_config = *config;
+    apply_sensor_settings();
+    return ESP_OK;
+}
+
+bool camera_ctrl_frame_size_supported(uint16_t width, uint16_t height)
+{
+    framesize_t size = find_frame_size(width, height);
+    framesize_t max_size = sensor_max_frame_size();
+    return size != FRAMESIZE_INVALID &&
+           resolution[size].width <= resolution[max_size].width &&
+           resolution[size].height <= resolution[max_size].height;
+}
+
+esp_err_t camera_ctrl_set_frame_size(uint16_t *width, uint16_t *height, bool raw)
+{
+    pixformat_t format = (s_sensor_jpeg && !raw) ? PIXFORMAT_JPEG : PIXFORMAT_RGB565;
+    if (!camera_ctrl_frame_size_supported(*width, *height)) {
+        // Never stream a different size under the requested one's label
+        ESP_LOGW(TAG, "%ux%u not available from sensor", *width, *height);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    framesize_t size = find_frame_size(*width, *height);
+
+    if (size != s_config.frame_size || format != s_config.pixel_format) {
+        // Frame buffers are sized at init, so a new size needs a re-init
+        camera_config_t config = s_config;
+        config.frame_size = size;
+        config.pixel_format = format;
+        esp_err_t err = reinit(&config);
+        if (err != ESP_OK) {
+            return err;
+        }
+        ESP_LOGI(TAG, "sensor frame size %ux%u", resolution[size].width, resolution[size].height);
+    }
+
+    *width = resolution[size].width;
+    *height = resolution[size].height;
+    return ESP_OK;
+}
+
+esp_err_t camera_ctrl_set_grab_latest(bool latest)
+{
+    camera_grab_mode_t mode = latest ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
+    if (s_config.grab_mode == mode) {
+        return ESP_OK;
+    }
+
+    camera_config_t config = s_config;
+    config.grab_mode = mode;
+    // The driver keeps overwriting its oldest buffer in LATEST mode; one
+    // more leaves a buffer to fill while the encoder holds its frame
+    config.fb_count = s_config.fb_count + (latest ? 1 : -1);
+    esp_err_t err = reinit(&config);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "grab mode %s, %u frame buffers",
+                 latest ? "latest" : "when-empty", (unsigned)config.fb_count);
+    }
+    return err;
+}
@@ -0,0 +1,140 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "esp_log.h"
+#include "bsp/esp-bsp.h"
+#include "camera_preview.h"
+
+static const char *TAG = "preview";
+
+// Picture-in-picture window width; the height follows the frame's aspect
+#define PREVIEW_PIP_WIDTH   96
+#define PREVIEW_PIP_MARGIN  6
+// How often the LVGL task looks for a newly shared frame
+#define PREVIEW_POLL_MS     20
+
+// The sensor delivers big-endian RGB565
+#if LVGL_VERSION_MAJOR > 9 || (LVGL_VERSION_MAJOR == 9 && LVGL_VERSION_MINOR >= 2)
+#define PREVIEW_COLOR_FORMAT  LV_COLOR_FORMAT_RGB565_SWAPPED
+#else
+#define PREVIEW_COLOR_FORMAT  LV_COLOR_FORMAT_RGB565
+#endif
+
+struct camera_preview_ref {
+    camera_fb_t *fb;
+    atomic_int refs;
+    atomic_bool busy;
+};
+
+// One frame on screen plus one waiting to be picked up
+static camera_preview_ref_t s_refs[2];
+static _Atomic(camera_preview_ref_t *) s_pending = NULL;
+
+// LVGL task only
+static lv_obj_t *s_img = NULL;
+static lv_image_dsc_t s_dsc[2];
+static int s_dsc_idx = 0;
+static camera_preview_ref_t *s_shown = NULL;
+
+void camera_preview_release(camera_preview_ref_t *ref)
+{
+    if (atomic_fetch_sub(&ref->refs, 1) == 1) {
+        camera_fb_t *fb = ref->fb;
+        ref->fb = NULL;
+        esp_camera_fb_return(fb);
+        atomic_store(&ref->busy, false);
+    }
+}
+
+static void show_frame(camera_preview_ref_t *ref)
+{
+    camera_fb_t *fb = ref->fb;
+
+    // Alternate descriptors so LVGL sees a new source every frame
+    s_dsc_idx ^= 1;
+    lv_image_dsc_t *dsc = &s_dsc[s_dsc_idx];
+    dsc->header.magic = LV_IMAGE_HEADER_MAGIC;
+    dsc->header.cf = PREVIEW_COLOR_FORMAT;
+    dsc->header.w = fb->width;
+    dsc->header.h = fb->height;
+    dsc->header.stride = fb->width * 2;
+    dsc->data = fb->buf;
+    dsc->data_size = fb->len;
+    lv_image_set_src(s_img, dsc);
+
+#if CONFIG_WEBCAM_CHAN_PREVIEW_PIP
+    uint32_t scale = (LV_SCALE_NONE * PREVIEW_PIP_WIDTH) / fb->width;
+#else
+    uint32_t scale = (LV_SCALE_NONE * (uint32_t)lv_obj_get_width(lv_obj_get_parent(s_img))) / fb->width;
+#endif
+    lv_image_set_scale(s_img, scale);
+    lv_obj_set_size(s_img, (fb->width * scale) / LV_SCALE_NONE, (fb->height * scale) / LV_SCALE_NONE);
+    lv_image_set_inner_align(s_img, LV_IMAGE_ALIGN_CENTER);
+    lv_obj_clear_flag(s_img, LV_OBJ_FLAG_HIDDEN);
+}
+
+static void preview_timer_cb(lv_timer_t *timer)
+{
+    camera_preview_ref_t *ref = atomic_exchange(&s_pending, NULL);
+    if (ref == NULL) {
+        return;
+    }
+    show_frame(ref);
+    if (s_shown != NULL) {
+        camera_preview_release(s_shown);
+    }
+    s_shown = ref;
+}
+
+void camera_preview_init(lv_obj_t *parent)
+{
+#if CONFIG_WEBCAM_CHAN_PREVIEW_FULL || CONFIG_WEBCAM_CHAN_PREVIEW_PIP
+    s_img = lv_image_create(parent);
+    lv_obj_add_flag(s_img, LV_OBJ_FLAG_HIDDEN);
+#if CONFIG_WEBCAM_CHAN_PREVIEW_PIP
+    lv_obj_align(s_img, LV_ALIGN_BOTTOM_RIGHT, -PREVIEW_PIP_MARGIN, -PREVIEW_PIP_MARGIN);
+#else
+    lv_obj_center(s_img);
+#endif
+    lv_timer_create(preview_timer_cb, PREVIEW_POLL_MS, NULL);
+    ESP_LOGI(TAG, "camera preview enabled");
+#else
+    (void)parent;
+#endif
+}
+
+camera_preview_ref_t *camera_preview_share(camera_fb_t *fb)
+{
+    if (s_img == NULL || fb->format != PIXFORMAT_RGB565 || atomic_load(&s_pending) != NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof(s_refs) / sizeof(s_refs[0]); i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&s_refs[i].busy, &expected, true)) {
+            camera_preview_ref_t *ref = &s_refs[i];
+            ref->fb = fb;
+            atomic_store(&ref->refs, 2);     // encoder + display
+            atomic_store(&s_pending, ref);
+            return ref;
+        }
+    }
+    return NULL;
+}
+
+void camera_preview_flush(void)
+{
+    if (s_img == NULL) {
+        return;
+    }
+    bsp_display_lock(0);
+    camera_preview_ref_t *pending = atomic_exchange(&s_pending, NULL);
+    if (pending != NULL) {
+        camera_preview_release(pending);
+    }
+    lv_obj_add_flag(s_img, LV_OBJ_FLAG_HIDDEN);
+    lv_image_set_src(s_img, NULL);
+    if (s_shown != NULL) {
+        camera_preview_release(s_shown);
+        s_shown = NULL;
+    }
+    bsp_display_unlock();
+}
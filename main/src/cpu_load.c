@@ -0,0 +1,27 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "cpu_load.h"
+
+static uint32_t s_prev_idle[CPU_LOAD_CORE_COUNT];
+static int64_t s_prev_time = 0;
+
+void cpu_load_sample(uint32_t load_x10[CPU_LOAD_CORE_COUNT])
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - s_prev_time;
+
+    for (int core = 0; core < CPU_LOAD_CORE_COUNT; core++) {
+        // Run time counter ticks in microseconds (esp_timer clock source)
+        uint32_t idle = (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        uint32_t idle_delta = idle - s_prev_idle[core];
+        s_prev_idle[core] = idle;
+
+        if (s_prev_time == 0 || elapsed <= 0 || idle_delta >= (uint64_t)elapsed) {
+            load_x10[core] = 0;
+        } else {
+            load_x10[core] = (uint32_t)(1000 - ((uint64_t)idle_delta * 1000) / (uint64_t)elapsed);
+        }
+    }
+    s_prev_time = now;
+}
@@ -0,0 +1,360 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_camera.h"
+#include "esp_console.h"
+#include "esp_log.h"
+#include "mbedtls/base64.h"
+#include "bsp/esp-bsp.h"
+#include "avatar.h"
+#include "boot_status.h"
+#include "camera_ctrl.h"
+#include "dev_console.h"
+#include "display_governor.h"
+#include "frame_pipeline.h"
+#include "frame_trace.h"
+#include "jpeg_encode.h"
+#include "mem_arena.h"
+#include "usb_descriptors_override.h"
+
+static const char *TAG = "console";
+
+// Frames discarded after a resolution change while exposure settles
+#define FRAMEDUMP_WARMUP_FRAMES  5
+// Raw bytes per base64 line (76 characters)
+#define FRAMEDUMP_LINE_BYTES     57
+// Time for the encoder task to finish its frame and let go of the camera
+#define FRAMEDUMP_BORROW_WAIT_MS 1000
+
+static int cmd_trace(int argc, char **argv)
+{
+    if (argc < 2) {
+        frame_trace_print_summary();
+    } else if (strcmp(argv[1], "raw") == 0) {
+        frame_trace_print_raw();
+    } else if (strcmp(argv[1], "clear") == 0) {
+        frame_trace_clear();
+    } else {
+        printf("usage: trace [raw|clear]\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_face(int argc, char **argv)
+{
+    stackchanface_redraw_stats_t stats;
+    bsp_display_lock(0);
+    stackchanface_get_redraw_stats(&stats);
+    bsp_display_unlock();
+
+    printf("expression changes %lu | last %lu px | avg %lu px\n",
+           (unsigned long)stats.changes, (unsigned long)stats.last_pixels,
+           (unsigned long)(stats.changes ? stats.total_pixels / stats.changes : 0));
+    return 0;
+}
+
+static int cmd_governor(int argc, char **argv)
+{
+    if (argc >= 2) {
+        if (strcmp(argv[1], "on") == 0) {
+            display_governor_enable(true);
+        } else if (strcmp(argv[1], "off") == 0) {
+            display_governor_enable(false);
+        } else {
+            printf("usage: governor [on|off]\n");
+            return 1;
+        }
+    }
+    printf("display governor %s\n", display_governor_enabled() ? "on" : "off");
+    return 0;
+}
+
+static int cmd_latency(int argc, char **argv)
+{
+    if (argc >= 2) {
+        if (strcmp(argv[1], "low") == 0) {
+            frame_pipeline_set_latency_mode(FRAME_LATENCY_LOW);
+        } else if (strcmp(argv[1], "throughput") == 0) {
+            frame_pipeline_set_latency_mode(FRAME_LATENCY_THROUGHPUT);
+        } else {
+            printf("usage: latency [low|throughput]\n");
+            return 1;
+        }
+    }
+
+    frame_pipeline_stats_t stats;
+    frame_pipeline_get_stats(&stats);
+    printf("latency mode %s | captured %lu dropped %lu stale %lu\n",
+           frame_pipeline_latency_mode() == FRAME_LATENCY_LOW ? "low" : "throughput",
+           (unsigned long)stats.captured, (unsigned long)stats.dropped,
+           (unsigned long)stats.stale);
+    return 0;
+}
+
+/*
+ * usb
+ *
+ * Streaming endpoint mode and the frame rates its bandwidth allows per
+ * resolution: YUY2 at its raw size, MJPEG at the JPEG byte budget. Build
+ * with and without CONFIG_UVC_MODE_BULK_CAM1 and compare with the
+ * measured "sent" rate from 'trace'.
+ */
+static int cmd_usb(int argc, char **argv)
+{
+    static const struct {
+        uint16_t width;
+        uint16_t height;
+    } sizes[] = { { 160, 120 }, { 320, 240 }, { 640, 480 } };
+
+    uint32_t per_second = usb_desc_stream_bytes_per_second();
+    printf("%s endpoint, %u-byte packets, %lu B/s payload\n", usb_desc_stream_mode(),
+           (unsigned)usb_desc_stream_ep_size(), (unsigned long)per_second);
+    printf("%-9s %12s %9s %9s\n", "size", "yuy2 bytes", "yuy2 fps", "mjpeg fps");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t raw = (uint32_t)sizes[i].width * sizes[i].height * 2;
+        uint32_t yuy2_x10 = (uint32_t)(((uint64_t)per_second * 10) / raw);
+        uint32_t mjpeg_x10 = (uint32_t)(((uint64_t)per_second * 10) / CONFIG_WEBCAM_CHAN_JPEG_TARGET_BYTES);
+        printf("%4ux%-4u %12lu %7lu.%lu %7lu.%lu\n", sizes[i].width, sizes[i].height,
+               (unsigned long)raw,
+               (unsigned long)(yuy2_x10 / 10), (unsigned long)(yuy2_x10 % 10),
+               (unsigned long)(mjpeg_x10 / 10), (unsigned long)(mjpeg_x10 % 10));
+    }
+    return 0;
+}
+
+/*
+ * strip [on|off]
+ *
+ * Software JPEG cost since the last toggle: average encode time and data
+ * stall cycles per frame. Stream, 'strip off', wait, 'strip', then the
+ * same with 'strip on', at each resolution to compare reading the frame
+ * from PSRAM with staging it through the GDMA strips.
+ */
+static int cmd_strip(int argc, char **argv)
+{
+    if (argc >= 2) {
+        if (strcmp(argv[1], "on") == 0) {
+            jpeg_encode_use_strips(true);
+        } else if (strcmp(argv[1], "off") == 0) {
+            jpeg_encode_use_strips(false);
+        } else {
+            printf("usage: strip [on|off]\n");
+            return 1;
+        }
+    }
+
+    jpeg_encode_profile_t profile;
+    jpeg_encode_get_profile(&profile);
+    printf("strip staging %s%s | frames %lu (%lu via strips) | encode avg %lu us | stalls avg %lu cycles\n",
+           jpeg_encode_strips_enabled() ? "on" : "off",
+           jpeg_encode_strips_available() ? "" : " (not available)",
+           (unsigned long)profile.frames, (unsigned long)profile.strip_frames,
+           (unsigned long)profile.encode_us_avg, (unsigned long)profile.stall_cycles_avg);
+    return 0;
+}
+
+/*
+ * dual [on|off]
+ *
+ * Same profile as 'strip', comparing the encoder task alone with the frame
+ * split into two restart bands encoded on both cores. Dual-core frames
+ * read PSRAM directly, so compare strips with 'dual off'.
+ */
+static int cmd_dual(int argc, char **argv)
+{
+    if (argc >= 2) {
+        if (strcmp(argv[1], "on") == 0) {
+            jpeg_encode_use_dual_core(true);
+        } else if (strcmp(argv[1], "off") == 0) {
+            jpeg_encode_use_dual_core(false);
+        } else {
+            printf("usage: dual [on|off]\n");
+            return 1;
+        }
+    }
+
+    jpeg_encode_profile_t profile;
+    jpeg_encode_get_profile(&profile);
+    printf("dual-core encode %s%s | frames %lu (%lu in two bands) | encode avg %lu us\n",
+           jpeg_encode_dual_core_enabled() ? "on" : "off",
+           jpeg_encode_dual_core_available() ? "" : " (not available)",
+           (unsigned long)profile.frames, (unsigned long)profile.dual_frames,
+           (unsigned long)profile.encode_us_avg);
+    return 0;
+}
+
+static int cmd_mem(int argc, char **argv)
+{
+    mem_arena_report();
+    return 0;
+}
+
+static int cmd_boot(int argc, char **argv)
+{
+    boot_status_print();
+    return 0;
+}
+
+/*
+ * framedump <width> <height> [count]
+ *
+ * Prints raw RGB565 sensor frames as base64 between "FRAME w h len" and
+ * "END" lines, for tools/bench/dump_frames.py. The camera is borrowed from
+ * the idle encoder task for the whole dump; a stream the host starts
+ * meanwhile waits until it is done.
+ */
+static int framedump_frames(uint16_t width, uint16_t height, int count)
+{
+    if (camera_ctrl_set_frame_size(&width, &height, true) != ESP_OK) {
+        printf("cannot configure %ux%u\n", width, height);
+        return 1;
+    }
+
+    for (int i = 0; i < FRAMEDUMP_WARMUP_FRAMES; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb != NULL) {
+            esp_camera_fb_return(fb);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb == NULL) {
+            printf("capture failed\n");
+            return 1;
+        }
+        if (fb->format != PIXFORMAT_RGB565) {
+            esp_camera_fb_return(fb);
+            printf("sensor is not delivering RGB565\n");
+            return 1;
+        }
+
+        printf("FRAME %u %u %u\n", fb->width, fb->height, (unsigned)fb->len);
+        unsigned char line[80];
+        for (size_t off = 0; off < fb->len; off += FRAMEDUMP_LINE_BYTES) {
+            size_t chunk = fb->len - off;
+            chunk = (chunk > FRAMEDUMP_LINE_BYTES) ? FRAMEDUMP_LINE_BYTES : chunk;
+            size_t olen = 0;
+            mbedtls_base64_encode(line, sizeof(line), &olen, fb->buf + off, chunk);
+            line[olen] = '\0';
+            printf("%s\n", line);
+        }
+        printf("END\n");
+        esp_camera_fb_return(fb);
+    }
+    return 0;
+}
+
+static int cmd_framedump(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("usage: framedump <width> <height> [count]\n");
+        return 1;
+    }
+    if (!frame_pipeline_ready()) {
+        printf("camera is not up yet\n");
+        return 1;
+    }
+    // A stream that just stopped may still be finishing its last frame
+    if (!frame_pipeline_borrow_camera(pdMS_TO_TICKS(FRAMEDUMP_BORROW_WAIT_MS))) {
+        printf("stop the UVC stream first\n");
+        return 1;
+    }
+
+    int ret = framedump_frames((uint16_t)atoi(argv[1]), (uint16_t)atoi(argv[2]),
+                               (argc > 3) ? atoi(argv[3]) : 1);
+    frame_pipeline_return_camera();
+    return ret;
+}
+
+esp_err_t dev_console_start(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "webcam>";
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+
+    esp_err_t err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "console init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const esp_console_cmd_t trace_cmd = {
+        .command = "trace",
+        .help = "Frame timing: per-stage p50/p99/max, 'raw' for CSV, 'clear' to reset",
+        .hint = "[raw|clear]",
+        .func = cmd_trace,
+    };
+    esp_console_cmd_register(&trace_cmd);
+
+    const esp_console_cmd_t face_cmd = {
+        .command = "face",
+        .help = "Avatar redraw cost: pixels invalidated per expression change",
+        .func = cmd_face,
+    };
+    esp_console_cmd_register(&face_cmd);
+
+    const esp_console_cmd_t governor_cmd = {
+        .command = "governor",
+        .help = "Keep LCD refreshes out of the encode while streaming",
+        .hint = "[on|off]",
+        .func = cmd_governor,
+    };
+    esp_console_cmd_register(&governor_cmd);
+
+    const esp_console_cmd_t latency_cmd = {
+        .command = "latency",
+        .help = "Capture mode: newest frame only ('low') or queued ('throughput')",
+        .hint = "[low|throughput]",
+        .func = cmd_latency,
+    };
+    esp_console_cmd_register(&latency_cmd);
+
+    const esp_console_cmd_t usb_cmd = {
+        .command = "usb",
+        .help = "Streaming endpoint mode and the frame rate its bandwidth allows per size",
+        .func = cmd_usb,
+    };
+    esp_console_cmd_register(&usb_cmd);
+
+    const esp_console_cmd_t strip_cmd = {
+        .command = "strip",
+        .help = "JPEG encode time and stall cycles, frame from PSRAM ('off') or GDMA strips ('on')",
+        .hint = "[on|off]",
+        .func = cmd_strip,
+    };
+    esp_console_cmd_register(&strip_cmd);
+
+    const esp_console_cmd_t dual_cmd = {
+        .command = "dual",
+        .help = "JPEG encode time on the encoder core ('off') or in two restart bands on both cores ('on')",
+        .hint = "[on|off]",
+        .func = cmd_dual,
+    };
+    esp_console_cmd_register(&dual_cmd);
+
+    const esp_console_cmd_t mem_cmd = {
+        .command = "mem",
+        .help = "Memory arena budget: capacity, used and high-water mark per region",
+        .func = cmd_mem,
+    };
+    esp_console_cmd_register(&mem_cmd);
+
+    const esp_console_cmd_t boot_cmd = {
+        .command = "boot",
+        .help = "Time from application start to each boot stage",
+        .func = cmd_boot,
+    };
+    esp_console_cmd_register(&boot_cmd);
+
+    const esp_console_cmd_t framedump_cmd = {
+        .command = "framedump",
+        .help = "Print raw RGB565 frames as base64 (see tools/bench/dump_frames.py)",
+        .hint = "<width> <height> [count]",
+        .func = cmd_framedump,
+    };
+    esp_console_cmd_register(&framedump_cmd);
+
+    return esp_console_start_repl(repl);
+}
@@ -0,0 +1,68 @@
+#include <stdatomic.h>
+#include "esp_log.h"
+#include "bsp/esp-bsp.h"
+#include "lvgl.h"
+#include "display_governor.h"
+
+static const char *TAG = "display_gov";
+
+// How long an encode waits for an in-progress LVGL render before going ahead
+#define DISPLAY_GOVERNOR_LOCK_WAIT_MS  5
+
+#if CONFIG_WEBCAM_CHAN_DISPLAY_GOVERNOR
+static atomic_bool s_enabled = true;
+#else
+static atomic_bool s_enabled = false;
+#endif
+static bool s_streaming = false;
+
+// Call with the display lock held
+static void apply_period(void)
+{
+    lv_display_t *disp = lv_display_get_default();
+    lv_timer_t *timer = (disp != NULL) ? lv_display_get_refr_timer(disp) : NULL;
+    if (timer == NULL) {
+        return;
+    }
+    bool slow = s_streaming && atomic_load(&s_enabled);
+    lv_timer_set_period(timer, slow ? CONFIG_WEBCAM_CHAN_DISPLAY_STREAM_REFR_MS : LV_DEF_REFR_PERIOD);
+    ESP_LOGI(TAG, "display refresh every %d ms",
+             slow ? CONFIG_WEBCAM_CHAN_DISPLAY_STREAM_REFR_MS : LV_DEF_REFR_PERIOD);
+}
+
+void display_governor_set_streaming(bool streaming)
+{
+    if (streaming != s_streaming) {
+        s_streaming = streaming;
+        apply_period();
+    }
+}
+
+void display_governor_enable(bool enable)
+{
+    atomic_store(&s_enabled, enable);
+    bsp_display_lock(0);
+    apply_period();
+    bsp_display_unlock();
+}
+
+bool display_governor_enabled(void)
+{
+    return atomic_load(&s_enabled);
+}
+
+bool display_governor_encode_begin(void)
+{
+    if (!atomic_load(&s_enabled)) {
+        return false;
+    }
+    // Holding the LVGL lock keeps renders and flushes out of the encode
+    return bsp_display_lock(DISPLAY_GOVERNOR_LOCK_WAIT_MS);
+}
+
+void display_governor_encode_end(bool held)
+{
+    if (held) {
+        bsp_display_unlock();
+    }
+}
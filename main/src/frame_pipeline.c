@@ -0,0 +1,804 @@
+/**
+ * Capture -> encode -> USB frame pipeline.
+ *
+ * A dedicated encoder task pinned to FRAME_PIPELINE_TASK_CORE grabs camera
+ * frames and JPEG-encodes them into a small ring of slots. The UVC task only
+ * picks up the newest READY slot, so frame N goes out over USB while frame
+ * N+1 is captured and encoded.
+ *
+ * Slot life cycle: FREE -> ENCODING -> READY -> IN_USB -> FREE.
+ * A READY slot that is superseded by a newer frame is recycled and counted
+ * as dropped.
+ *
+ * Each slot owns a fixed output buffer allocated once by
+ * frame_pipeline_alloc_buffers(), so the steady-state frame path does not
+ * touch the heap. Frames that would not fit fail cleanly and are counted
+ * as encode failures.
+ *
+ * frame_pipeline_start() only records the host-negotiated format; the
+ * encoder task reconfigures the sensor for it before the first capture and
+ * then paces captures to the requested frame interval.
+ *
+ * In FRAME_PIPELINE_SENSOR_JPEG mode the sensor already delivers JPEG, so
+ * the slot keeps the camera frame itself and hands fb->buf to USB without
+ * conversion or copy; the frame goes back to the camera driver when the
+ * slot is freed.
+ *
+ * For the uncompressed YUY2 format the sensor always delivers RGB565 and
+ * the "encode" stage is a single-pass RGB565 -> YUYV conversion.
+ *
+ * With CONFIG_WEBCAM_CHAN_SLICED_JPEG a software JPEG frame is published
+ * as soon as its headers are written and grows one MCU row at a time, so
+ * USB can start sending it while the rest is encoded. The encoder marks it
+ * done or failed at the end; USB releases it once the last byte is out.
+ *
+ * FRAME_LATENCY_LOW trades completeness for glass-to-USB latency: the
+ * camera only keeps its newest frame, a capture that is already too old
+ * is skipped in favour of the next one, and the USB task never waits
+ * longer than one frame interval for a frame.
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "frame_pipeline.h"
+#include "display_governor.h"
+#include "image_adjust.h"
+#include "jpeg_encode.h"
+#include "jpeg_rate_ctrl.h"
+#include "cpu_load.h"
+#include "camera_ctrl.h"
+#include "camera_preview.h"
+#include "color_conv.h"
+#include "mem_arena.h"
+#include "uvc_telemetry.h"
+
+static const char *TAG = "pipeline";
+
+static frame_slot_t s_slots[FRAME_PIPELINE_SLOT_COUNT];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_ready_sem = NULL;
+static TaskHandle_t s_task = NULL;
+// Held by the encoder task except while it idles, so a console tool that
+// borrows the camera never races a capture, re-init or SCCB write
+static SemaphoreHandle_t s_camera_mutex = NULL;
+static volatile bool s_streaming = false;
+// Set once the camera and display are up; until then a stream waits
+static volatile bool s_ready = false;
+static uint32_t s_seq = 0;
+static frame_pipeline_mode_t s_mode = FRAME_PIPELINE_SW_JPEG;
+
+// Host-negotiated format, applied by the encoder task
+static volatile bool s_format_pending = false;
+static frame_format_t s_format = FRAME_FORMAT_MJPEG;
+static frame_format_t s_req_format = FRAME_FORMAT_MJPEG;
+static uint16_t s_req_width = 0;
+static uint16_t s_req_height = 0;
+static uint32_t s_req_fps = 0;
+
+// Latency mode requested (any task) and applied to the camera (encoder task)
+#if CONFIG_WEBCAM_CHAN_LOW_LATENCY
+static volatile frame_latency_mode_t s_latency_mode = FRAME_LATENCY_LOW;
+#else
+static volatile frame_latency_mode_t s_latency_mode = FRAME_LATENCY_THROUGHPUT;
+#endif
+static frame_latency_mode_t s_latency_applied = FRAME_LATENCY_THROUGHPUT;
+static volatile TickType_t s_frame_period = 0;
+
+static void (*s_slice_listener)(void) = NULL;
+static void (*s_slice_abort)(void) = NULL;
+
+static frame_pipeline_stats_t s_stats;
+static uint64_t s_encode_us_total = 0;
+static uint64_t s_heap_allocs_in_encode = 0;
+
+#if CONFIG_WEBCAM_CHAN_HEAP_ALLOC_COUNT
+// Soak counter: every heap allocation in the system bumps this
+static volatile uint32_t s_heap_alloc_count = 0;
+
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    __atomic_fetch_add(&s_heap_alloc_count, 1, __ATOMIC_RELAXED);
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+}
+
+static inline uint32_t heap_alloc_count(void)
+{
+    return __atomic_load_n(&s_heap_alloc_count, __ATOMIC_RELAXED);
+}
+#else
+static inline uint32_t heap_alloc_count(void)
+{
+    return 0;
+}
+#endif
+
+// Mark a slot FREE; returns the camera frame it held, to be returned
+// to the driver once the lock is released
+static camera_fb_t *slot_free_locked(frame_slot_t *slot)
+{
+    camera_fb_t *fb = slot->fb;
+    slot->fb = NULL;
+    slot->state = FRAME_SLOT_FREE;
+    return fb;
+}
+
+static void return_camera_fbs(camera_fb_t **fbs, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (fbs[i] != NULL) {
+            esp_camera_fb_return(fbs[i]);
+        }
+    }
+}
+
+// Record a finished frame that never reached USB
+static void trace_drop_locked(frame_slot_t *slot)
+{
+    slot->trace.dropped = true;
+    frame_trace_push(&slot->trace);
+}
+
+static uint32_t count_ready_locked(void)
+{
+    uint32_t depth = 0;
+    for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+        if (s_slots[i].state == FRAME_SLOT_READY) {
+            depth++;
+        }
+    }
+    return depth;
+}
+
+// Pick a FREE slot, or recycle the oldest READY slot when none is free
+static frame_slot_t *claim_slot(void)
+{
+    frame_slot_t *claimed = NULL;
+    frame_slot_t *oldest_ready = NULL;
+    camera_fb_t *stale_fb = NULL;
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+        frame_slot_t *slot = &s_slots[i];
+        if (slot->state == FRAME_SLOT_FREE) {
+            claimed = slot;
+            break;
+        }
+        if (slot->state == FRAME_SLOT_READY &&
+            (oldest_ready == NULL || (int32_t)(slot->seq - oldest_ready->seq) < 0)) {
+            oldest_ready = slot;
+        }
+    }
+    if (claimed == NULL && oldest_ready != NULL) {
+        claimed = oldest_ready;
+        trace_drop_locked(claimed);
+        stale_fb = slot_free_locked(claimed);
+        s_stats.dropped++;
+    }
+    if (claimed != NULL) {
+        claimed->state = FRAME_SLOT_ENCODING;
+        claimed->live = FRAME_LIVE_NONE;
+        claimed->live_len = 0;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return_camera_fbs(&stale_fb, 1);
+    return claimed;
+}
+
+static bool convert_into_slot(camera_fb_t *fb, frame_slot_t *slot)
+{
+    size_t pixels = (size_t)fb->width * fb->height;
+    if (fb->format != PIXFORMAT_RGB565 || pixels * 2 > slot->capacity) {
+        return false;
+    }
+
+    color_conv_rgb565_to_yuyv(fb->buf, slot->buf, pixels);
+    slot->data = slot->buf;
+    slot->len = pixels * 2;
+    slot->width = fb->width;
+    slot->height = fb->height;
+    slot->timestamp = fb->timestamp;
+    return true;
+}
+
+#if CONFIG_WEBCAM_CHAN_SLICED_JPEG
+// The first slice carries the headers and makes the frame available to
+// USB; later ones only move live_len forward
+static void publish_slice(size_t bytes, void *arg)
+{
+    frame_slot_t *slot = (frame_slot_t *)arg;
+    __atomic_store_n(&slot->live_len, (uint32_t)bytes, __ATOMIC_RELEASE);
+    if (slot->live == FRAME_LIVE_NONE && s_streaming) {
+        taskENTER_CRITICAL(&s_lock);
+        slot->seq = ++s_seq;
+        slot->live = FRAME_LIVE_ENCODING;
+        taskEXIT_CRITICAL(&s_lock);
+        xSemaphoreGive(s_ready_sem);
+    }
+    if (s_slice_listener != NULL) {
+        s_slice_listener();
+    }
+}
+#endif
+
+static bool encode_into_slot(camera_fb_t *fb, frame_slot_t *slot)
+{
+    if (s_format == FRAME_FORMAT_YUY2) {
+        return convert_into_slot(fb, slot);
+    }
+
+    if (fb->format == PIXFORMAT_JPEG) {
+        if (fb->len == 0) {
+            return false;
+        }
+        // Zero-copy: USB reads the camera frame buffer directly
+        slot->fb = fb;
+        slot->data = fb->buf;
+        slot->len = fb->len;
+        slot->width = fb->width;
+        slot->height = fb->height;
+        slot->timestamp = fb->timestamp;
+        return true;
+    }
+
+    slot->data = slot->buf;
+    slot->width = fb->width;
+    slot->height = fb->height;
+    slot->timestamp = fb->timestamp;
+
+    size_t out_len = 0;
+#if CONFIG_WEBCAM_CHAN_SLICED_JPEG
+    bool converted = jpeg_encode_sliced_into(fb, jpeg_rate_ctrl_quality(), slot->buf,
+                                             slot->capacity, &out_len, publish_slice, slot);
+#else
+    bool converted = jpeg_encode_into(fb, jpeg_rate_ctrl_quality(),
+                                      slot->buf, slot->capacity, &out_len);
+#endif
+    slot->len = converted ? out_len : 0;
+    return converted;
+}
+
+static void log_stats(int64_t elapsed_us, const frame_pipeline_stats_t *prev)
+{
+    frame_pipeline_stats_t cur;
+    frame_pipeline_get_stats(&cur);
+
+    uint32_t capture_fps_x10 = (uint32_t)(((uint64_t)(cur.captured - prev->captured) * 10000000ULL) / elapsed_us);
+    uint32_t encode_fps_x10 = (uint32_t)(((uint64_t)(cur.encoded - prev->encoded) * 10000000ULL) / elapsed_us);
+    uint32_t usb_fps_x10 = (uint32_t)(((uint64_t)(cur.sent - prev->sent) * 10000000ULL) / elapsed_us);
+
+    uint32_t cpu_load_x10[CPU_LOAD_CORE_COUNT];
+    cpu_load_sample(cpu_load_x10);
+
+    taskENTER_CRITICAL(&s_lock);
+    s_stats.capture_fps_x10 = capture_fps_x10;
+    s_stats.encode_fps_x10 = encode_fps_x10;
+    s_stats.usb_fps_x10 = usb_fps_x10;
+    for (int core = 0; core < CPU_LOAD_CORE_COUNT; core++) {
+        s_stats.cpu_load_x10[core] = cpu_load_x10[core];
+    }
+    cur = s_stats;
+    taskEXIT_CRITICAL(&s_lock);
+    uvc_telemetry_publish(&cur);
+
+    ESP_LOGI(TAG, "[%s] cpu0 %lu.%lu%% cpu1 %lu.%lu%%",
+             s_mode == FRAME_PIPELINE_SENSOR_JPEG ? "sensor-jpeg" : jpeg_encode_backend_name(),
+             (unsigned long)(cpu_load_x10[0] / 10), (unsigned long)(cpu_load_x10[0] % 10),
+             (unsigned long)(cpu_load_x10[1] / 10), (unsigned long)(cpu_load_x10[1] % 10));
+    if (s_mode == FRAME_PIPELINE_SW_JPEG && s_format == FRAME_FORMAT_MJPEG) {
+        ESP_LOGI(TAG, "jpeg q%lu | %lu B avg, target %lu B @ %lu fps",
+                 (unsigned long)cur.jpeg_quality, (unsigned long)cur.jpeg_bytes_avg,
+                 (unsigned long)cur.jpeg_target_bytes, (unsigned long)cur.target_fps);
+    }
+    ESP_LOGI(TAG, "fps capture %lu.%lu encode %lu.%lu usb %lu.%lu | enc %lu us | depth %lu max %lu | drop %lu stale %lu fail %lu",
+             (unsigned long)(capture_fps_x10 / 10), (unsigned long)(capture_fps_x10 % 10),
+             (unsigned long)(encode_fps_x10 / 10), (unsigned long)(encode_fps_x10 % 10),
+             (unsigned long)(usb_fps_x10 / 10), (unsigned long)(usb_fps_x10 % 10),
+             (unsigned long)cur.encode_us_avg,
+             (unsigned long)cur.queue_depth, (unsigned long)cur.queue_depth_max,
+             (unsigned long)cur.dropped, (unsigned long)cur.stale,
+             (unsigned long)cur.encode_failed);
+#if CONFIG_WEBCAM_CHAN_HEAP_ALLOC_COUNT
+    ESP_LOGI(TAG, "heap allocs/frame %lu.%02lu",
+             (unsigned long)(cur.heap_allocs_per_frame_x100 / 100),
+             (unsigned long)(cur.heap_allocs_per_frame_x100 % 100));
+#endif
+}
+
+// Idle counterpart of log_stats: no frame rates, but current CPU load, so
+// telemetry polled between streams is not the last stream's
+static void publish_idle_stats(void)
+{
+    uint32_t cpu_load_x10[CPU_LOAD_CORE_COUNT];
+    cpu_load_sample(cpu_load_x10);
+
+    frame_pipeline_stats_t cur;
+    taskENTER_CRITICAL(&s_lock);
+    s_stats.capture_fps_x10 = 0;
+    s_stats.encode_fps_x10 = 0;
+    s_stats.usb_fps_x10 = 0;
+    for (int core = 0; core < CPU_LOAD_CORE_COUNT; core++) {
+        s_stats.cpu_load_x10[core] = cpu_load_x10[core];
+    }
+    cur = s_stats;
+    taskEXIT_CRITICAL(&s_lock);
+    uvc_telemetry_publish(&cur);
+}
+
+// False when the sensor is left at another size than the committed one;
+// the stream is then stopped instead of sending frames the host misdecodes
+static bool apply_requested_format(TickType_t *period_out)
+{
+    uint16_t width = s_req_width;
+    uint16_t height = s_req_height;
+    uint32_t fps = s_req_fps;
+    s_format = s_req_format;
+    s_format_pending = false;
+
+    if (camera_ctrl_set_frame_size(&width, &height, s_format == FRAME_FORMAT_YUY2) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to reconfigure sensor for %ux%u, stopping the stream",
+                 s_req_width, s_req_height);
+        // Unless the host has already committed another size meanwhile
+        if (!s_format_pending) {
+            s_streaming = false;
+        }
+        return false;
+    }
+    ESP_LOGI(TAG, "streaming %s %ux%u @ %lu fps (requested %ux%u)",
+             s_format == FRAME_FORMAT_YUY2 ? "YUY2" : "MJPEG",
+             width, height, (unsigned long)fps, s_req_width, s_req_height);
+
+    jpeg_rate_ctrl_reset(s_slots[0].capacity, fps);
+
+    *period_out = 0;
+    if (fps > 0) {
+        TickType_t period = pdMS_TO_TICKS(1000 / fps);
+        *period_out = (period > 0) ? period : 1;
+    }
+    return true;
+}
+
+// Sensor JPEG slots keep their camera frame until USB is done with it
+static bool slots_hold_camera_frames(void)
+{
+    bool held = false;
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+        held |= (s_slots[i].fb != NULL);
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return held;
+}
+
+static void apply_latency_mode(void)
+{
+    frame_latency_mode_t mode = s_latency_mode;
+    // The re-init frees every frame buffer, including shown ones
+    camera_preview_flush();
+    if (camera_ctrl_set_grab_latest(mode == FRAME_LATENCY_LOW) != ESP_OK) {
+        ESP_LOGE(TAG, "failed to switch camera grab mode");
+    }
+    s_latency_applied = mode;
+    ESP_LOGI(TAG, "latency mode %s", mode == FRAME_LATENCY_LOW ? "low" : "throughput");
+}
+
+// Sensor capture older than the staleness budget when the encoder got it
+static bool frame_is_stale(const camera_fb_t *fb)
+{
+    int64_t captured = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+    return esp_timer_get_time() - captured > (int64_t)CONFIG_WEBCAM_CHAN_STALE_FRAME_MS * 1000;
+}
+
+static void encoder_task(void *arg)
+{
+    frame_pipeline_stats_t prev = {0};
+    int64_t last_log_time = esp_timer_get_time();
+    TickType_t frame_period = 0;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    xSemaphoreTake(s_camera_mutex, portMAX_DELAY);
+    for (;;) {
+        if (!s_streaming || !s_ready) {
+            if (s_ready) {
+                camera_preview_flush();
+            }
+            xSemaphoreGive(s_camera_mutex);
+            bool woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FRAME_PIPELINE_STATS_PERIOD_US / 1000)) != 0;
+            if (!woken) {
+                publish_idle_stats();
+            }
+            xSemaphoreTake(s_camera_mutex, portMAX_DELAY);
+            if (!woken) {
+                continue;
+            }
+            // Woken by start, readiness or a control change; apply the
+            // latter now, or once the sensor is there
+            if (s_ready) {
+                image_adjust_apply_if_changed();
+            }
+            frame_pipeline_get_stats(&prev);
+            cpu_load_sample(prev.cpu_load_x10);
+            last_log_time = esp_timer_get_time();
+            continue;
+        }
+
+        if (s_format_pending) {
+            // The re-init frees every frame buffer, including shown ones
+            camera_preview_flush();
+            if (!apply_requested_format(&frame_period)) {
+                continue;
+            }
+            s_frame_period = frame_period;
+            last_wake = xTaskGetTickCount();
+        }
+        if (s_latency_mode != s_latency_applied && !slots_hold_camera_frames()) {
+            apply_latency_mode();
+            last_wake = xTaskGetTickCount();
+        }
+
+        // Pace captures to the host-requested frame interval
+        if (frame_period > 0) {
+            xTaskDelayUntil(&last_wake, frame_period);
+        }
+
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb != NULL && s_latency_applied == FRAME_LATENCY_LOW && frame_is_stale(fb)) {
+            // The driver holds only its newest frame, so one retry is enough
+            esp_camera_fb_return(fb);
+            taskENTER_CRITICAL(&s_lock);
+            s_stats.stale++;
+            taskEXIT_CRITICAL(&s_lock);
+            fb = esp_camera_fb_get();
+        }
+        if (fb == NULL) {
+            continue;
+        }
+        frame_trace_t trace = {0};
+        frame_trace_stamp(&trace, FRAME_TRACE_FB_GET);
+        trace.t[FRAME_TRACE_SENSOR] = (uint32_t)((int64_t)fb->timestamp.tv_sec * 1000000 +
+                                                 fb->timestamp.tv_usec);
+
+        taskENTER_CRITICAL(&s_lock);
+        s_stats.captured++;
+        taskEXIT_CRITICAL(&s_lock);
+
+        frame_slot_t *slot = claim_slot();
+        if (slot == NULL) {
+            // Every slot is busy (USB + encoding); drop this capture
+            esp_camera_fb_return(fb);
+            taskENTER_CRITICAL(&s_lock);
+            s_stats.dropped++;
+            taskEXIT_CRITICAL(&s_lock);
+            continue;
+        }
+
+        // Picture controls are folded into the conversion tables
+        image_adjust_apply_if_changed();
+
+        // The LCD preview shares the frame instead of copying it
+        camera_preview_ref_t *preview = camera_preview_share(fb);
+
+        bool display_held = display_governor_encode_begin();
+        uint32_t allocs_before = heap_alloc_count();
+        int64_t encode_start = esp_timer_get_time();
+        // A sliced frame can reach USB mid-encode, so its trace is in place first
+        trace.t[FRAME_TRACE_ENC_START] = (uint32_t)encode_start;
+        slot->trace = trace;
+        bool ok = encode_into_slot(fb, slot);
+        int64_t encode_end = esp_timer_get_time();
+        display_governor_encode_end(display_held);
+        int64_t encode_us = encode_end - encode_start;
+        uint32_t allocs = heap_alloc_count() - allocs_before;
+
+        // Only software-encoded frames feed the quality controller
+        bool sw_jpeg = (s_format == FRAME_FORMAT_MJPEG && fb->format != PIXFORMAT_JPEG);
+        jpeg_rate_ctrl_state_t rc = {0};
+        if (sw_jpeg) {
+            jpeg_rate_ctrl_update(ok, slot->len, (uint32_t)encode_us);
+            jpeg_rate_ctrl_get_state(&rc);
+        }
+
+        // The RGB565 frame is no longer needed once encoded; sensor JPEG
+        // frames stay attached to their slot until USB is done with them.
+        // A frame shared with the preview goes back once both let go
+        if (preview != NULL) {
+            camera_preview_release(preview);
+        } else if (slot->fb != fb) {
+            esp_camera_fb_return(fb);
+        }
+
+        if (ok) {
+            uvc_telemetry_record_frame((uint32_t)encode_us, (uint32_t)slot->len);
+        }
+
+        camera_fb_t *unused_fb = NULL;
+        taskENTER_CRITICAL(&s_lock);
+        bool published = (slot->live != FRAME_LIVE_NONE);
+        if (published && slot->state == FRAME_SLOT_ENCODING) {
+            // USB never picked it up mid-encode: an ordinary finished frame
+            slot->live = FRAME_LIVE_NONE;
+        } else if (published) {
+            // USB is sending it and ends the frame on this
+            __atomic_store_n(&slot->live, ok ? FRAME_LIVE_DONE : FRAME_LIVE_FAILED, __ATOMIC_RELEASE);
+        }
+        if (ok && s_streaming) {
+            if (!published) {
+                slot->seq = ++s_seq;
+            }
+            slot->trace.seq = slot->seq;
+            slot->trace.bytes = (uint32_t)slot->len;
+            slot->trace.t[FRAME_TRACE_ENC_END] = (uint32_t)encode_end;
+            if (slot->state == FRAME_SLOT_ENCODING) {
+                slot->state = FRAME_SLOT_READY;
+            }
+            s_stats.encoded++;
+            s_encode_us_total += (uint64_t)encode_us;
+            s_stats.encode_us_avg = (uint32_t)(s_encode_us_total / s_stats.encoded);
+            s_heap_allocs_in_encode += allocs;
+            s_stats.heap_allocs_per_frame_x100 = (uint32_t)((s_heap_allocs_in_encode * 100) / s_stats.encoded);
+        } else {
+            // A sliced frame USB holds is freed by its release
+            if (slot->state == FRAME_SLOT_ENCODING) {
+                unused_fb = slot_free_locked(slot);
+            }
+            if (!ok) {
+                s_stats.encode_failed++;
+            }
+        }
+        if (sw_jpeg) {
+            s_stats.jpeg_quality = rc.quality;
+            s_stats.jpeg_target_bytes = rc.target_bytes;
+            s_stats.jpeg_bytes_avg = rc.bytes_avg;
+            s_stats.target_fps = rc.target_fps;
+        }
+        s_stats.queue_depth = count_ready_locked();
+        if (s_stats.queue_depth > s_stats.queue_depth_max) {
+            s_stats.queue_depth_max = s_stats.queue_depth;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+
+        return_camera_fbs(&unused_fb, 1);
+        if (published && s_slice_listener != NULL) {
+            s_slice_listener();
+        }
+        if (ok) {
+            xSemaphoreGive(s_ready_sem);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_log_time >= FRAME_PIPELINE_STATS_PERIOD_US) {
+            log_stats(now - last_log_time, &prev);
+            frame_pipeline_get_stats(&prev);
+            last_log_time = now;
+        }
+    }
+}
+
+esp_err_t frame_pipeline_init(void)
+{
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    s_ready_sem = xSemaphoreCreateBinary();
+    if (s_ready_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_camera_mutex = xSemaphoreCreateMutex();
+    if (s_camera_mutex == NULL) {
+        vSemaphoreDelete(s_ready_sem);
+        s_ready_sem = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(encoder_task, "jpeg_enc",
+                                                 FRAME_PIPELINE_TASK_STACK, NULL,
+                                                 FRAME_PIPELINE_TASK_PRIO, &s_task,
+                                                 FRAME_PIPELINE_TASK_CORE);
+    if (created != pdPASS) {
+        vSemaphoreDelete(s_camera_mutex);
+        s_camera_mutex = NULL;
+        vSemaphoreDelete(s_ready_sem);
+        s_ready_sem = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void frame_pipeline_alloc_buffers(size_t buf_size)
+{
+    for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+        frame_slot_t *slot = &s_slots[i];
+        if (slot->buf != NULL) {
+            continue;
+        }
+        // 16-byte alignment lets the SIMD color conversion store directly
+        slot->buf = mem_arena_alloc(MEM_ARENA_PSRAM, buf_size, 16, "pipeline slot");
+        slot->capacity = buf_size;
+        slot->len = 0;
+    }
+}
+
+void frame_pipeline_start(frame_format_t format, uint16_t width, uint16_t height, uint32_t fps)
+{
+    s_req_format = format;
+    s_req_width = width;
+    s_req_height = height;
+    s_req_fps = fps;
+    s_format_pending = true;
+    s_streaming = true;
+    xTaskNotifyGive(s_task);
+}
+
+void frame_pipeline_stop(void)
+{
+    s_streaming = false;
+    // A sliced frame USB holds or is about to take goes with its slot
+    if (s_slice_abort != NULL) {
+        s_slice_abort();
+    }
+
+    // The slot being encoded is released by the encoder task itself
+    camera_fb_t *held[FRAME_PIPELINE_SLOT_COUNT] = {0};
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+        if (s_slots[i].state == FRAME_SLOT_READY || s_slots[i].state == FRAME_SLOT_IN_USB) {
+            held[i] = slot_free_locked(&s_slots[i]);
+        }
+    }
+    s_stats.queue_depth = 0;
+    taskEXIT_CRITICAL(&s_lock);
+
+    return_camera_fbs(held, FRAME_PIPELINE_SLOT_COUNT);
+
+    xSemaphoreTake(s_ready_sem, 0);
+}
+
+void frame_pipeline_wake(void)
+{
+    if (s_task != NULL) {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+bool frame_pipeline_streaming(void)
+{
+    return s_streaming;
+}
+
+bool frame_pipeline_borrow_camera(TickType_t wait)
+{
+    if (s_streaming || xSemaphoreTake(s_camera_mutex, wait) != pdTRUE) {
+        return false;
+    }
+    // A stream may have started while the encoder task let go
+    if (s_streaming) {
+        xSemaphoreGive(s_camera_mutex);
+        return false;
+    }
+    return true;
+}
+
+void frame_pipeline_return_camera(void)
+{
+    xSemaphoreGive(s_camera_mutex);
+}
+
+void frame_pipeline_set_ready(frame_pipeline_mode_t mode)
+{
+    s_mode = mode;
+    s_ready = true;
+    xTaskNotifyGive(s_task);
+}
+
+bool frame_pipeline_ready(void)
+{
+    return s_ready;
+}
+
+void frame_pipeline_set_latency_mode(frame_latency_mode_t mode)
+{
+    s_latency_mode = mode;
+}
+
+frame_latency_mode_t frame_pipeline_latency_mode(void)
+{
+    return s_latency_mode;
+}
+
+frame_slot_t *frame_pipeline_acquire(TickType_t wait)
+{
+    // A frame that misses its interval is better skipped than sent late
+    TickType_t period = s_frame_period;
+    if (s_latency_mode == FRAME_LATENCY_LOW && period > 0 && period < wait) {
+        wait = period;
+    }
+
+    for (;;) {
+        frame_slot_t *newest = NULL;
+        camera_fb_t *stale[FRAME_PIPELINE_SLOT_COUNT] = {0};
+
+        taskENTER_CRITICAL(&s_lock);
+        for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+            frame_slot_t *slot = &s_slots[i];
+            bool sliced = (slot->state == FRAME_SLOT_ENCODING && slot->live == FRAME_LIVE_ENCODING);
+            if ((slot->state == FRAME_SLOT_READY || sliced) &&
+                (newest == NULL || (int32_t)(slot->seq - newest->seq) > 0)) {
+                newest = slot;
+            }
+        }
+        if (newest != NULL) {
+            // Anything older than the newest finished frame is stale
+            for (int i = 0; i < FRAME_PIPELINE_SLOT_COUNT; i++) {
+                frame_slot_t *slot = &s_slots[i];
+                if (slot != newest && slot->state == FRAME_SLOT_READY) {
+                    trace_drop_locked(slot);
+                    stale[i] = slot_free_locked(slot);
+                    s_stats.dropped++;
+                }
+            }
+            newest->state = FRAME_SLOT_IN_USB;
+            s_stats.queue_depth = 0;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+
+        return_camera_fbs(stale, FRAME_PIPELINE_SLOT_COUNT);
+        if (newest != NULL) {
+            return newest;
+        }
+        if (!s_streaming || xSemaphoreTake(s_ready_sem, wait) != pdTRUE) {
+            return NULL;
+        }
+    }
+}
+
+void frame_pipeline_release(frame_slot_t *slot)
+{
+    if (slot == NULL) {
+        return;
+    }
+
+    camera_fb_t *fb = NULL;
+    taskENTER_CRITICAL(&s_lock);
+    if (slot->state == FRAME_SLOT_IN_USB) {
+        frame_trace_stamp(&slot->trace, FRAME_TRACE_RETURN);
+        frame_trace_push(&slot->trace);
+        fb = slot_free_locked(slot);
+        s_stats.sent++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return_camera_fbs(&fb, 1);
+}
+
+uint32_t frame_pipeline_live_progress(const frame_slot_t *slot, frame_live_t *state)
+{
+    *state = __atomic_load_n(&slot->live, __ATOMIC_ACQUIRE);
+    // Only the finished frame has its EOI and last bits in len
+    if (*state == FRAME_LIVE_DONE) {
+        return (uint32_t)slot->len;
+    }
+    return __atomic_load_n(&slot->live_len, __ATOMIC_ACQUIRE);
+}
+
+void frame_pipeline_set_slice_listener(void (*listener)(void), void (*abort)(void))
+{
+    s_slice_listener = listener;
+    s_slice_abort = abort;
+}
+
+void frame_pipeline_get_stats(frame_pipeline_stats_t *out)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_lock);
+}
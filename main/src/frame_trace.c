@@ -0,0 +1,183 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_trace.h"
+
+/*
+ * Multi-producer ring: a writer reserves an index with one atomic add,
+ * fills the entry and then publishes it by storing index + 1 in commit.
+ * Readers copy an entry and keep it only if commit was stable across the
+ * copy, so a reader never blocks a writer (and vice versa).
+ */
+
+typedef struct {
+    atomic_uint commit;         // 0 = empty / being written, else index + 1
+    frame_trace_t rec;
+} trace_entry_t;
+
+static trace_entry_t s_ring[FRAME_TRACE_DEPTH];
+static atomic_uint s_head = 0;
+static atomic_uint s_dropped = 0;
+
+// Intervals reported by the summary, as (from, to) stage pairs
+static const struct {
+    const char *name;
+    frame_trace_stage_t from;
+    frame_trace_stage_t to;
+} s_intervals[] = {
+    { "sensor->fb_get", FRAME_TRACE_SENSOR, FRAME_TRACE_FB_GET },
+    { "fb_get->enc", FRAME_TRACE_FB_GET, FRAME_TRACE_ENC_START },
+    { "encode", FRAME_TRACE_ENC_START, FRAME_TRACE_ENC_END },
+    { "enc->handoff", FRAME_TRACE_ENC_END, FRAME_TRACE_HANDOFF },
+    { "handoff->return", FRAME_TRACE_HANDOFF, FRAME_TRACE_RETURN },
+    { "sensor->return", FRAME_TRACE_SENSOR, FRAME_TRACE_RETURN },
+};
+
+void frame_trace_push(const frame_trace_t *trace)
+{
+    unsigned idx = atomic_fetch_add_explicit(&s_head, 1, memory_order_relaxed);
+    trace_entry_t *e = &s_ring[idx % FRAME_TRACE_DEPTH];
+
+    atomic_store_explicit(&e->commit, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    e->rec = *trace;
+    atomic_store_explicit(&e->commit, idx + 1, memory_order_release);
+
+    if (trace->dropped) {
+        atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+    }
+}
+
+uint32_t frame_trace_dropped(void)
+{
+    return atomic_load_explicit(&s_dropped, memory_order_relaxed);
+}
+
+// Copy the published entries, oldest first; returns how many were copied
+static size_t snapshot(frame_trace_t *out)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned first = (head > FRAME_TRACE_DEPTH) ? head - FRAME_TRACE_DEPTH : 0;
+    size_t n = 0;
+
+    for (unsigned idx = first; idx != head; idx++) {
+        trace_entry_t *e = &s_ring[idx % FRAME_TRACE_DEPTH];
+        unsigned before = atomic_load_explicit(&e->commit, memory_order_acquire);
+        if (before != idx + 1) {
+            continue;   // Not yet published, or already overwritten
+        }
+        out[n] = e->rec;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&e->commit, memory_order_relaxed) == before) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Console-only paths, so the snapshot buffers come from the heap
+void frame_trace_print_summary(void)
+{
+    frame_trace_t *recs = malloc(sizeof(frame_trace_t) * FRAME_TRACE_DEPTH);
+    uint32_t *deltas = malloc(sizeof(uint32_t) * FRAME_TRACE_DEPTH);
+    if (recs == NULL || deltas == NULL) {
+        free(recs);
+        free(deltas);
+        return;
+    }
+
+    size_t n = snapshot(recs);
+    size_t dropped = 0;
+    uint64_t sent_bytes = 0;
+    const frame_trace_t *first = NULL;
+    const frame_trace_t *last = NULL;
+    for (size_t i = 0; i < n; i++) {
+        if (recs[i].dropped) {
+            dropped++;
+            continue;
+        }
+        // Bytes of every sent frame after the first, over the handoff span
+        if (first == NULL) {
+            first = &recs[i];
+        } else {
+            sent_bytes += recs[i].bytes;
+        }
+        last = &recs[i];
+    }
+    printf("frames %u (dropped %u in window, %lu total)\n",
+           (unsigned)n, (unsigned)dropped, (unsigned long)frame_trace_dropped());
+    if (first != NULL && last != first) {
+        uint32_t span_us = last->t[FRAME_TRACE_HANDOFF] - first->t[FRAME_TRACE_HANDOFF];
+        if (span_us > 0) {
+            printf("sent %lu B/s\n", (unsigned long)((sent_bytes * 1000000) / span_us));
+        }
+    }
+    printf("%-16s %8s %8s %8s %8s  (us)\n", "stage", "p50", "p99", "max", "jitter");
+
+    for (size_t k = 0; k < sizeof(s_intervals) / sizeof(s_intervals[0]); k++) {
+        size_t m = 0;
+        for (size_t i = 0; i < n; i++) {
+            const frame_trace_t *r = &recs[i];
+            if (r->dropped && s_intervals[k].to >= FRAME_TRACE_HANDOFF) {
+                continue;   // Dropped frames never reach USB
+            }
+            // Sliced frames reach USB before their encode ends; count that as 0
+            int32_t delta = (int32_t)(r->t[s_intervals[k].to] - r->t[s_intervals[k].from]);
+            deltas[m++] = (delta > 0) ? (uint32_t)delta : 0;
+        }
+        if (m == 0) {
+            printf("%-16s %8s %8s %8s %8s\n", s_intervals[k].name, "-", "-", "-", "-");
+            continue;
+        }
+        qsort(deltas, m, sizeof(deltas[0]), cmp_u32);
+        // Jitter: spread between the typical and the slow tail
+        uint32_t p50 = deltas[(m - 1) / 2];
+        uint32_t p99 = deltas[((m - 1) * 99) / 100];
+        printf("%-16s %8lu %8lu %8lu %8lu\n", s_intervals[k].name,
+               (unsigned long)p50, (unsigned long)p99,
+               (unsigned long)deltas[m - 1], (unsigned long)(p99 - p50));
+    }
+    free(recs);
+    free(deltas);
+}
+
+void frame_trace_print_raw(void)
+{
+    frame_trace_t *recs = malloc(sizeof(frame_trace_t) * FRAME_TRACE_DEPTH);
+    if (recs == NULL) {
+        return;
+    }
+
+    size_t n = snapshot(recs);
+    printf("seq,sensor_us,fb_get,enc_start,enc_end,handoff,return,bytes,dropped\n");
+    for (size_t i = 0; i < n; i++) {
+        const frame_trace_t *r = &recs[i];
+        uint32_t t0 = r->t[FRAME_TRACE_SENSOR];
+        // Later stages as offsets from the sensor timestamp
+        printf("%lu,%lu", (unsigned long)r->seq, (unsigned long)t0);
+        for (int s = FRAME_TRACE_FB_GET; s < FRAME_TRACE_STAGE_COUNT; s++) {
+            if (r->dropped && s >= FRAME_TRACE_HANDOFF) {
+                printf(",");
+            } else {
+                printf(",%lu", (unsigned long)(r->t[s] - t0));
+            }
+        }
+        printf(",%lu,%d\n", (unsigned long)r->bytes, r->dropped ? 1 : 0);
+    }
+    free(recs);
+}
+
+void frame_trace_clear(void)
+{
+    for (size_t i = 0; i < FRAME_TRACE_DEPTH; i++) {
+        atomic_store_explicit(&s_ring[i].commit, 0, memory_order_relaxed);
+    }
+}
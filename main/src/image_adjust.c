@@ -0,0 +1,94 @@
+#include <math.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "camera_ctrl.h"
+#include "color_conv.h"
+#include "jpeg_encode.h"
+#include "uvc_ctrl_params.h"
+#include "uvc_ctrl_state.h"
+#include "image_adjust.h"
+
+static const char *TAG = "image_adjust";
+
+// Odd, so the first call always applies (snapshot sequences are even)
+static uint32_t s_applied = 1;
+
+static int clamp_ctrl(const uvc_ctrl_state_t *snap, const uvc_ctrl_entry_t *entry)
+{
+    int64_t v = uvc_ctrl_state_value(snap, entry);
+    return (int)(v < entry->min ? entry->min : (v > entry->max ? entry->max : v));
+}
+
+static int16_t clamp_q7(float v)
+{
+    long q = lroundf(v);
+    return (int16_t)(q < -255 ? -255 : (q > 255 ? 255 : q));
+}
+
+void image_adjust_apply_if_changed(void)
+{
+    if (uvc_ctrl_state_sequence() == s_applied) {
+        return;
+    }
+    uvc_ctrl_state_t snap;
+    s_applied = uvc_ctrl_state_snapshot(&snap);
+
+    // Hand each control to the sensor ISP first; whatever it lacks is
+    // done in software and the rest stays neutral there
+    int brightness = 128;
+    int contrast = 128;
+    int hue = 128;
+    int saturation = 128;
+    unsigned hw_mask = 0;
+    for (size_t i = 0; i < g_uvc_ctrl_entry_count; i++) {
+        const uvc_ctrl_entry_t *entry = &g_uvc_ctrl_entries[i];
+        int value = clamp_ctrl(&snap, entry);
+#if CONFIG_WEBCAM_CHAN_PU_SENSOR_OFFLOAD
+        if (camera_ctrl_set_control(entry->entity_id, entry->control_selector, value) == ESP_OK) {
+            hw_mask |= 1u << i;
+            value = entry->def;
+        }
+#endif
+        if (entry->entity_id != UVC_ENTITY_ID_PROCESSING_UNIT) {
+            continue;
+        }
+        switch (entry->control_selector) {
+        case UVC_PU_BRIGHTNESS_CONTROL:
+            brightness = value;
+            break;
+        case UVC_PU_CONTRAST_CONTROL:
+            contrast = value;
+            break;
+        case UVC_PU_HUE_CONTROL:
+            hue = value;
+            break;
+        case UVC_PU_SATURATION_CONTROL:
+            saturation = value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Hue 0..255 spans -180..+180 degrees; saturation scales both axes
+    float theta = (float)(hue - 128) * (float)M_PI / 128.0f;
+    float c = (float)saturation * cosf(theta);
+    float s = (float)saturation * sinf(theta);
+
+    jpeg_enc_adjust_t adjust = {
+        .y_gain = (int16_t)contrast,
+        .y_offset = (int16_t)((brightness - 128) / 2),
+        .chroma = { clamp_q7(c), clamp_q7(-s), clamp_q7(s), clamp_q7(c) },
+    };
+    jpeg_encode_set_adjust(&adjust);
+
+    color_conv_adjust_t yuv = {
+        .y_gain = adjust.y_gain,
+        .y_offset = adjust.y_offset,
+        .chroma = { adjust.chroma[0], adjust.chroma[1], adjust.chroma[2], adjust.chroma[3] },
+    };
+    color_conv_set_adjust(&yuv);
+
+    ESP_LOGI(TAG, "sensor mask 0x%04x | software brightness %d contrast %d hue %d saturation %d",
+             hw_mask, brightness, contrast, hue, saturation);
+}
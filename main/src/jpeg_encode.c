@@ -0,0 +1,632 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+#include "esp_async_memcpy.h"
+#include "esp_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+#include "xtensa_perfmon_access.h"
+#include "xtensa_perfmon_masks.h"
+#include "jpeg_enc.h"
+#include "jpeg_encode.h"
+#include "mem_arena.h"
+
+/*
+ * With CONFIG_WEBCAM_CHAN_JPEG_STRIP_DMA the in-tree encoder does not read
+ * the frame from PSRAM. Each MCU row (16 lines) is copied by GDMA
+ * (esp_async_memcpy) into one of two internal SRAM strips while the CPU
+ * encodes the previous strip from the other, so the 16-line MCU access
+ * pattern no longer thrashes the small PSRAM cache:
+ *
+ *   GDMA:  copy 0 | copy 1   | copy 2   | ...
+ *   CPU:          | encode 0 | encode 1 | encode 2 ...
+ *
+ * The frame is written back from the cache before the first copy, since
+ * esp32-camera fills RGB565 frame buffers with the CPU.
+ *
+ * With CONFIG_WEBCAM_CHAN_JPEG_DUAL_CORE a frame is instead split into two
+ * horizontal bands separated by a JPEG restart marker. The calling encoder
+ * task (core 1) encodes the top band into the output buffer while a band
+ * task on core 0 encodes the bottom band into its own buffer (s_band_buf);
+ * the bottom band is then copied behind an RST0 marker:
+ *
+ *   core 1:  headers + DRI | band 0 ........ | RST0 + copy band 1 | EOI
+ *   core 0:                | band 1 ........ |
+ *
+ * Both bands read the frame straight from PSRAM; the strips are a single
+ * GDMA pipeline and stay with the single-core path.
+ */
+
+static const char *TAG = "jpeg_encode";
+
+// Widest frame the strips hold (the sensor maximum, VGA)
+#define STRIP_MAX_WIDTH         640
+#define STRIP_BYTES             (STRIP_MAX_WIDTH * 2 * JPEG_ENC_MCU_SIZE)
+#define STRIP_DMA_ALIGN         16
+// A strip copy is ~20 us; anything near this means the DMA is gone
+#define STRIP_COPY_TIMEOUT_MS   20
+
+// Performance counter for the data-stall cycles of the encoding core
+#define STALL_COUNTER           0
+
+// Bottom-band encoder; the encoder task itself runs on core 1
+#define BAND_TASK_CORE          0
+#define BAND_TASK_PRIO          4
+#define BAND_TASK_STACK         3072
+
+// Only the encoder task encodes, so one context is enough. It holds the
+// per-MCU workspace and the quantization tables and comes from the
+// internal SRAM arena so that it is part of the boot budget
+static jpeg_enc_t *s_enc = NULL;
+
+static uint8_t *s_strip[2] = { NULL, NULL };
+static async_memcpy_handle_t s_dma = NULL;
+static SemaphoreHandle_t s_strip_done = NULL;
+static volatile bool s_strips_enabled = true;
+
+// Bottom band of a dual-core frame, handed to s_band_task
+typedef struct {
+    const camera_fb_t *fb;
+    uint16_t first_row;     // In MCU rows
+    uint16_t rows;
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    bool ok;
+} band_job_t;
+
+static jpeg_enc_t *s_band_enc = NULL;
+static TaskHandle_t s_band_task = NULL;
+static SemaphoreHandle_t s_band_done = NULL;
+static band_job_t s_band_job;
+// The bottom band's own output, so the top band may use the whole frame
+// buffer; only the stitched total has to fit
+static uint8_t *s_band_buf = NULL;
+static size_t s_band_buf_size = 0;
+static volatile bool s_dual_enabled = true;
+
+// Bit per core whose stall counter is running
+static uint32_t s_stall_cores = 0;
+
+static portMUX_TYPE s_profile_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_profile_frames = 0;
+static uint32_t s_profile_strip_frames = 0;
+static uint32_t s_profile_dual_frames = 0;
+static uint64_t s_profile_us_total = 0;
+static uint64_t s_profile_stalls_total = 0;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} jpeg_sink_t;
+
+static size_t jpeg_sink_write(void *arg, size_t index, const void *data, size_t len)
+{
+    jpeg_sink_t *sink = (jpeg_sink_t *)arg;
+    if (sink->overflow || index + len > sink->size) {
+        // Returning short makes the encoder abort the frame
+        sink->overflow = true;
+        return 0;
+    }
+    memcpy(sink->buf + index, data, len);
+    if (index + len > sink->len) {
+        sink->len = index + len;
+    }
+    return len;
+}
+
+static bool frame2jpg_into(camera_fb_t *fb, uint8_t quality,
+                           uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    jpeg_sink_t sink = {
+        .buf = buf,
+        .size = buf_size,
+        .len = 0,
+        .overflow = false,
+    };
+
+    *out_len = 0;
+    bool converted = frame2jpg_cb(fb, quality, jpeg_sink_write, &sink);
+    if (!converted || sink.overflow || sink.len == 0) {
+        return false;
+    }
+    *out_len = sink.len;
+    return true;
+}
+
+/*
+ * Data-stall cycles of the calling core so far. The ESP32-S3 external
+ * memory cache has no miss counter, so the cycles the core waits on data
+ * loads stand in for PSRAM cache misses.
+ */
+static uint32_t stall_cycles(void)
+{
+    uint32_t core = 1u << xPortGetCoreID();
+    if ((s_stall_cores & core) == 0) {
+        xtensa_perfmon_init(STALL_COUNTER, XTPERF_CNT_D_STALL, XTPERF_MASK_D_STALL_BUSY, 0, -1);
+        xtensa_perfmon_start();
+        s_stall_cores |= core;
+    }
+    return xtensa_perfmon_value(STALL_COUNTER);
+}
+
+static bool IRAM_ATTR strip_copied(async_memcpy_handle_t dma, async_memcpy_event_t *event, void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_strip_done, &woken);
+    return woken == pdTRUE;
+}
+
+static uint16_t strip_rows(const camera_fb_t *fb, int index)
+{
+    uint16_t left = fb->height - index * JPEG_ENC_MCU_SIZE;
+    return (left < JPEG_ENC_MCU_SIZE) ? left : JPEG_ENC_MCU_SIZE;
+}
+
+// Start copying MCU row `index` into its strip; done is signalled on s_strip_done
+static void strip_fetch(const camera_fb_t *fb, int index)
+{
+    size_t stride = (size_t)fb->width * 2;
+    uint8_t *src = fb->buf + (size_t)index * JPEG_ENC_MCU_SIZE * stride;
+    uint8_t *dst = s_strip[index & 1];
+    size_t len = strip_rows(fb, index) * stride;
+
+    if (esp_async_memcpy(s_dma, dst, src, len, strip_copied, NULL) != ESP_OK) {
+        // Keep this frame going with a CPU copy; later frames read PSRAM directly
+        ESP_LOGW(TAG, "GDMA copy rejected, strip staging off");
+        s_strips_enabled = false;
+        memcpy(dst, src, len);
+        xSemaphoreGive(s_strip_done);
+    }
+}
+
+static bool encode_strips(camera_fb_t *fb, uint8_t quality, uint8_t *buf, size_t buf_size,
+                          size_t *out_len, jpeg_encode_slice_cb_t on_slice, void *arg)
+{
+    *out_len = 0;
+    jpeg_enc_set_quality(s_enc, quality);
+    if (!jpeg_enc_begin(s_enc, fb->width, fb->height, buf, buf_size)) {
+        return false;
+    }
+    if (on_slice != NULL) {
+        on_slice(jpeg_enc_output_len(s_enc), arg);
+    }
+
+    esp_cache_msync(fb->buf, fb->len, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_UNALIGNED);
+
+    int count = (fb->height + JPEG_ENC_MCU_SIZE - 1) / JPEG_ENC_MCU_SIZE;
+    int queued = 1;
+    bool ok = true;
+    // Clear a completion left over from a copy an earlier frame gave up on
+    xSemaphoreTake(s_strip_done, 0);
+    strip_fetch(fb, 0);
+    for (int i = 0; i < count && ok; i++) {
+        // Wait for strip i, then queue i + 1 so the copy overlaps the encode
+        if (xSemaphoreTake(s_strip_done, pdMS_TO_TICKS(STRIP_COPY_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "GDMA copy timed out, strip staging off");
+            s_strips_enabled = false;
+            ok = false;
+            break;
+        }
+        queued--;
+        if (i + 1 < count) {
+            strip_fetch(fb, i + 1);
+            queued++;
+        }
+        ok = jpeg_enc_encode_strip(s_enc, s_strip[i & 1], strip_rows(fb, i));
+        if (ok && on_slice != NULL) {
+            on_slice(jpeg_enc_output_len(s_enc), arg);
+        }
+    }
+    // After an overflow or a timeout a copy may still be in flight
+    while (queued > 0 && xSemaphoreTake(s_strip_done, pdMS_TO_TICKS(STRIP_COPY_TIMEOUT_MS)) == pdTRUE) {
+        queued--;
+    }
+    return jpeg_enc_finish(s_enc, out_len) && ok;
+}
+
+// Encode MCU rows [first, first + count) straight from the frame
+static bool encode_band_rows(jpeg_enc_t *enc, const camera_fb_t *fb, uint16_t first, uint16_t count,
+                             jpeg_encode_slice_cb_t on_slice, void *arg)
+{
+    size_t stride = (size_t)fb->width * 2;
+    for (int i = first; i < first + count; i++) {
+        if (!jpeg_enc_encode_strip(enc, fb->buf + (size_t)i * JPEG_ENC_MCU_SIZE * stride,
+                                   strip_rows(fb, i))) {
+            return false;
+        }
+        if (on_slice != NULL) {
+            on_slice(jpeg_enc_output_len(enc), arg);
+        }
+    }
+    return true;
+}
+
+// Same MCU-row walk straight over the PSRAM frame
+static bool encode_rows(camera_fb_t *fb, uint8_t quality, uint8_t *buf, size_t buf_size,
+                        size_t *out_len, jpeg_encode_slice_cb_t on_slice, void *arg)
+{
+    *out_len = 0;
+    jpeg_enc_set_quality(s_enc, quality);
+    if (!jpeg_enc_begin(s_enc, fb->width, fb->height, buf, buf_size)) {
+        return false;
+    }
+    if (on_slice != NULL) {
+        on_slice(jpeg_enc_output_len(s_enc), arg);
+    }
+
+    uint16_t count = (fb->height + JPEG_ENC_MCU_SIZE - 1) / JPEG_ENC_MCU_SIZE;
+    bool ok = encode_band_rows(s_enc, fb, 0, count, on_slice, arg);
+    return jpeg_enc_finish(s_enc, out_len) && ok;
+}
+
+#if CONFIG_WEBCAM_CHAN_JPEG_DUAL_CORE
+static void band_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        band_job_t *job = &s_band_job;
+        job->len = 0;
+        job->ok = jpeg_enc_begin_band(s_band_enc, job->fb->width, job->out, job->cap) &&
+                  encode_band_rows(s_band_enc, job->fb, job->first_row, job->rows, NULL, NULL) &&
+                  jpeg_enc_end_band(s_band_enc, &job->len);
+        xSemaphoreGive(s_band_done);
+    }
+}
+#endif
+
+static bool dual_usable(const camera_fb_t *fb)
+{
+    return s_dual_enabled && s_band_task != NULL && s_band_buf != NULL && fb->height > JPEG_ENC_MCU_SIZE &&
+           jpeg_enc_band_rows(fb->width, fb->height, 2) != 0;
+}
+
+// Top band into buf, bottom band on the band task into s_band_buf, then
+// appended behind the top one
+static bool encode_dual(camera_fb_t *fb, uint8_t quality, uint8_t *buf, size_t buf_size,
+                        size_t *out_len, jpeg_encode_slice_cb_t on_slice, void *arg)
+{
+    *out_len = 0;
+    uint16_t band_rows = jpeg_enc_band_rows(fb->width, fb->height, 2);
+    uint16_t mcu_rows = (fb->height + JPEG_ENC_MCU_SIZE - 1) / JPEG_ENC_MCU_SIZE;
+
+    jpeg_enc_set_quality(s_enc, quality);
+    jpeg_enc_set_quality(s_band_enc, quality);
+    if (!jpeg_enc_begin_restart(s_enc, fb->width, fb->height, band_rows, buf, buf_size)) {
+        return false;
+    }
+    if (on_slice != NULL) {
+        on_slice(jpeg_enc_output_len(s_enc), arg);
+    }
+
+    s_band_job = (band_job_t) {
+        .fb = fb,
+        .first_row = band_rows,
+        .rows = mcu_rows - band_rows,
+        .out = s_band_buf,
+        .cap = s_band_buf_size,
+    };
+    xTaskNotifyGive(s_band_task);
+
+    bool ok = encode_band_rows(s_enc, fb, 0, band_rows, on_slice, arg);
+    // s_band_buf is reused by the next frame, so the band must end here
+    xSemaphoreTake(s_band_done, portMAX_DELAY);
+
+    // Fails, leaving buf_size untouched, when the two bands do not fit together
+    ok = ok && s_band_job.ok && jpeg_enc_restart(s_enc, s_band_job.out, s_band_job.len);
+    return jpeg_enc_finish(s_enc, out_len) && ok;
+}
+
+static bool jpeg_enc_dual_into(camera_fb_t *fb, uint8_t quality,
+                               uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    return encode_dual(fb, quality, buf, buf_size, out_len, NULL, NULL);
+}
+
+static bool jpeg_enc_strips_into(camera_fb_t *fb, uint8_t quality,
+                                 uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    return encode_strips(fb, quality, buf, buf_size, out_len, NULL, NULL);
+}
+
+static bool jpeg_enc_direct_into(camera_fb_t *fb, uint8_t quality,
+                                 uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    jpeg_enc_set_quality(s_enc, quality);
+    return jpeg_enc_encode(s_enc, fb->buf, fb->width, fb->height, buf, buf_size, out_len);
+}
+
+static bool strips_usable(const camera_fb_t *fb)
+{
+    return s_strips_enabled && s_dma != NULL && fb->width <= STRIP_MAX_WIDTH &&
+           ((uintptr_t)fb->buf % STRIP_DMA_ALIGN) == 0;
+}
+
+static bool jpeg_enc_into(camera_fb_t *fb, uint8_t quality,
+                          uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+    if (fb->format != PIXFORMAT_RGB565 || (fb->width % JPEG_ENC_MCU_SIZE) != 0) {
+        return frame2jpg_into(fb, quality, buf, buf_size, out_len);
+    }
+    if (dual_usable(fb)) {
+        return jpeg_enc_dual_into(fb, quality, buf, buf_size, out_len);
+    }
+    if (strips_usable(fb)) {
+        return jpeg_enc_strips_into(fb, quality, buf, buf_size, out_len);
+    }
+    return jpeg_enc_direct_into(fb, quality, buf, buf_size, out_len);
+}
+
+static void strips_init(void)
+{
+#if CONFIG_WEBCAM_CHAN_JPEG_STRIP_DMA
+    for (int i = 0; i < 2; i++) {
+        s_strip[i] = mem_arena_alloc(MEM_ARENA_SRAM_DMA, STRIP_BYTES, STRIP_DMA_ALIGN, "jpeg strip");
+    }
+    s_strip_done = xSemaphoreCreateBinary();
+
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    config.backlog = 2;
+    esp_err_t err = (s_strip_done != NULL) ? esp_async_memcpy_install(&config, &s_dma) : ESP_ERR_NO_MEM;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "no GDMA channel (%s), encoding from PSRAM", esp_err_to_name(err));
+        s_dma = NULL;
+    }
+#endif
+}
+
+static void dual_init(void)
+{
+#if CONFIG_WEBCAM_CHAN_JPEG_DUAL_CORE
+    s_band_enc = mem_arena_alloc(MEM_ARENA_SRAM_DMA, sizeof(jpeg_enc_t), 16, "jpeg_enc band context");
+    jpeg_enc_init(s_band_enc);
+    s_band_done = xSemaphoreCreateBinary();
+    if (s_band_done == NULL ||
+        xTaskCreatePinnedToCore(band_task, "jpeg_band", BAND_TASK_STACK, NULL,
+                                BAND_TASK_PRIO, &s_band_task, BAND_TASK_CORE) != pdPASS) {
+        ESP_LOGW(TAG, "no band task, encoding on one core");
+        s_band_task = NULL;
+    }
+#endif
+}
+
+void jpeg_encode_alloc_buffers(size_t frame_bytes)
+{
+#if CONFIG_WEBCAM_CHAN_JPEG_DUAL_CORE
+    if (s_band_task != NULL && s_band_buf == NULL) {
+        s_band_buf = mem_arena_alloc(MEM_ARENA_PSRAM, frame_bytes, 16, "jpeg bottom band");
+        s_band_buf_size = frame_bytes;
+    }
+#else
+    (void)frame_bytes;
+#endif
+}
+
+void jpeg_encode_init(void)
+{
+    s_enc = mem_arena_alloc(MEM_ARENA_SRAM_DMA, sizeof(jpeg_enc_t), 16, "jpeg_enc context");
+    jpeg_enc_init(s_enc);
+    strips_init();
+    dual_init();
+    if (!jpeg_enc_selftest()) {
+        ESP_LOGW(TAG, "SIMD JPEG kernel mismatch, using scalar path");
+    }
+    ESP_LOGI(TAG, "backend: %s", jpeg_encode_backend_name());
+}
+
+static void profile_add(bool dual, bool strips, int64_t us, uint32_t stalls)
+{
+    portENTER_CRITICAL(&s_profile_lock);
+    s_profile_frames++;
+    s_profile_dual_frames += dual ? 1 : 0;
+    s_profile_strip_frames += strips ? 1 : 0;
+    s_profile_us_total += (uint64_t)us;
+    s_profile_stalls_total += stalls;
+    portEXIT_CRITICAL(&s_profile_lock);
+}
+
+bool jpeg_encode_into(camera_fb_t *fb, uint8_t quality,
+                      uint8_t *buf, size_t buf_size, size_t *out_len)
+{
+#if CONFIG_WEBCAM_CHAN_JPEG_ENCODER_INTREE
+    bool dual = dual_usable(fb);
+    bool strips = !dual && strips_usable(fb);
+    uint32_t stalls = stall_cycles();
+    int64_t start = esp_timer_get_time();
+    bool ok = jpeg_enc_into(fb, quality, buf, buf_size, out_len);
+    int64_t us = esp_timer_get_time() - start;
+    stalls = stall_cycles() - stalls;
+
+    if (ok) {
+        profile_add(dual, strips, us, stalls);
+    }
+    return ok;
+#else
+    return frame2jpg_into(fb, quality, buf, buf_size, out_len);
+#endif
+}
+
+bool jpeg_encode_sliced_into(camera_fb_t *fb, uint8_t quality, uint8_t *buf, size_t buf_size,
+                             size_t *out_len, jpeg_encode_slice_cb_t on_slice, void *arg)
+{
+#if CONFIG_WEBCAM_CHAN_JPEG_ENCODER_INTREE
+    if (fb->format != PIXFORMAT_RGB565 || (fb->width % JPEG_ENC_MCU_SIZE) != 0) {
+        return frame2jpg_into(fb, quality, buf, buf_size, out_len);
+    }
+
+    bool dual = dual_usable(fb);
+    bool strips = !dual && strips_usable(fb);
+    uint32_t stalls = stall_cycles();
+    int64_t start = esp_timer_get_time();
+    bool ok;
+    if (dual) {
+        // Only the top band is reported as it grows; the bottom one lands at the end
+        ok = encode_dual(fb, quality, buf, buf_size, out_len, on_slice, arg);
+    } else if (strips) {
+        ok = encode_strips(fb, quality, buf, buf_size, out_len, on_slice, arg);
+    } else {
+        ok = encode_rows(fb, quality, buf, buf_size, out_len, on_slice, arg);
+    }
+    int64_t us = esp_timer_get_time() - start;
+    stalls = stall_cycles() - stalls;
+
+    if (ok) {
+        profile_add(dual, strips, us, stalls);
+    }
+    return ok;
+#else
+    return frame2jpg_into(fb, quality, buf, buf_size, out_len);
+#endif
+}
+
+void jpeg_encode_use_strips(bool enable)
+{
+    s_strips_enabled = enable;
+    jpeg_encode_reset_profile();
+}
+
+bool jpeg_encode_strips_available(void)
+{
+    return s_dma != NULL;
+}
+
+void jpeg_encode_use_dual_core(bool enable)
+{
+    s_dual_enabled = enable;
+    jpeg_encode_reset_profile();
+}
+
+bool jpeg_encode_dual_core_available(void)
+{
+    return s_band_task != NULL;
+}
+
+bool jpeg_encode_dual_core_enabled(void)
+{
+    return s_dual_enabled && s_band_task != NULL;
+}
+
+bool jpeg_encode_strips_enabled(void)
+{
+    return s_strips_enabled && s_dma != NULL;
+}
+
+void jpeg_encode_get_profile(jpeg_encode_profile_t *out)
+{
+    portENTER_CRITICAL(&s_profile_lock);
+    out->frames = s_profile_frames;
+    out->strip_frames = s_profile_strip_frames;
+    out->dual_frames = s_profile_dual_frames;
+    out->encode_us_avg = s_profile_frames ? (uint32_t)(s_profile_us_total / s_profile_frames) : 0;
+    out->stall_cycles_avg = s_profile_frames ? (uint32_t)(s_profile_stalls_total / s_profile_frames) : 0;
+    portEXIT_CRITICAL(&s_profile_lock);
+}
+
+void jpeg_encode_reset_profile(void)
+{
+    portENTER_CRITICAL(&s_profile_lock);
+    s_profile_frames = 0;
+    s_profile_strip_frames = 0;
+    s_profile_dual_frames = 0;
+    s_profile_us_total = 0;
+    s_profile_stalls_total = 0;
+    portEXIT_CRITICAL(&s_profile_lock);
+}
+
+void jpeg_encode_set_adjust(const jpeg_enc_adjust_t *adjust)
+{
+    jpeg_enc_set_adjust(s_enc, adjust);
+    if (s_band_enc != NULL) {
+        jpeg_enc_set_adjust(s_band_enc, adjust);
+    }
+}
+
+const char *jpeg_encode_backend_name(void)
+{
+#if CONFIG_WEBCAM_CHAN_JPEG_ENCODER_INTREE
+    return jpeg_enc_simd_active() ? "jpeg_enc/pie" : "jpeg_enc/scalar";
+#else
+    return "frame2jpg";
+#endif
+}
+
+static int64_t time_encode(bool (*encode)(camera_fb_t *, uint8_t, uint8_t *, size_t, size_t *),
+                           camera_fb_t *fb, uint8_t *buf, size_t buf_size, size_t *len,
+                           uint32_t *stalls)
+{
+    uint32_t stalls_start = stall_cycles();
+    int64_t start = esp_timer_get_time();
+    if (!encode(fb, JPEG_ENCODE_DEFAULT_QUALITY, buf, buf_size, len)) {
+        return -1;
+    }
+    int64_t us = esp_timer_get_time() - start;
+    *stalls = stall_cycles() - stalls_start;
+    return us;
+}
+
+void jpeg_encode_benchmark(camera_fb_t *fb)
+{
+    if (fb->format != PIXFORMAT_RGB565) {
+        return;
+    }
+    // Boot-time scratch: shows up in the arena's high-water mark only
+    size_t buf_size = fb->len;
+    mem_arena_scratch_begin(MEM_ARENA_PSRAM);
+    uint8_t *buf = mem_arena_alloc(MEM_ARENA_PSRAM, buf_size, 16, "jpeg benchmark");
+
+    size_t len_ref = 0;
+    size_t len_scalar = 0;
+    size_t len_simd = 0;
+    uint32_t stalls = 0;
+    int64_t us_ref = time_encode(frame2jpg_into, fb, buf, buf_size, &len_ref, &stalls);
+
+    bool simd = jpeg_enc_simd_active();
+    jpeg_enc_use_simd(false);
+    int64_t us_scalar = time_encode(jpeg_enc_direct_into, fb, buf, buf_size, &len_scalar, &stalls);
+    jpeg_enc_use_simd(true);
+    int64_t us_simd = simd ? time_encode(jpeg_enc_direct_into, fb, buf, buf_size, &len_simd, &stalls) : -1;
+
+    ESP_LOGI(TAG, "%ux%u q%d: frame2jpg %lld us (%u B) | jpeg_enc scalar %lld us (%u B) | pie %lld us (%u B)",
+             fb->width, fb->height, JPEG_ENCODE_DEFAULT_QUALITY,
+             us_ref, (unsigned)len_ref, us_scalar, (unsigned)len_scalar,
+             us_simd, (unsigned)len_simd);
+
+    // Same encoder, frame read from PSRAM vs. staged through the SRAM strips
+    if (s_dma != NULL && fb->width <= STRIP_MAX_WIDTH && (fb->width % JPEG_ENC_MCU_SIZE) == 0) {
+        size_t len_direct = 0;
+        size_t len_strips = 0;
+        uint32_t stalls_direct = 0;
+        uint32_t stalls_strips = 0;
+        int64_t us_direct = time_encode(jpeg_enc_direct_into, fb, buf, buf_size, &len_direct, &stalls_direct);
+        int64_t us_strips = time_encode(jpeg_enc_strips_into, fb, buf, buf_size, &len_strips, &stalls_strips);
+        ESP_LOGI(TAG, "%ux%u from psram %lld us, %lu stall cycles | gdma strips %lld us, %lu stall cycles%s",
+                 fb->width, fb->height, us_direct, (unsigned long)stalls_direct,
+                 us_strips, (unsigned long)stalls_strips,
+                 (len_direct == len_strips) ? "" : " (sizes differ)");
+    }
+
+    // One core vs. two restart bands (a few bytes larger for DRI and RST0).
+    // On the band task's own core the bands would run one after the other
+    bool dual = s_band_task != NULL && s_band_buf != NULL && fb->height > JPEG_ENC_MCU_SIZE &&
+                (fb->width % JPEG_ENC_MCU_SIZE) == 0;
+    if (dual && xPortGetCoreID() == BAND_TASK_CORE) {
+        ESP_LOGW(TAG, "two bands not timed: benchmark runs on the band task's core %d", BAND_TASK_CORE);
+        dual = false;
+    }
+    if (dual) {
+        size_t len_single = 0;
+        size_t len_dual = 0;
+        uint32_t stalls_single = 0;
+        uint32_t stalls_dual = 0;
+        int64_t us_single = time_encode(jpeg_enc_direct_into, fb, buf, buf_size, &len_single, &stalls_single);
+        int64_t us_dual = time_encode(jpeg_enc_dual_into, fb, buf, buf_size, &len_dual, &stalls_dual);
+        ESP_LOGI(TAG, "%ux%u one core %lld us (%u B) | two bands %lld us (%u B)",
+                 fb->width, fb->height, us_single, (unsigned)len_single, us_dual, (unsigned)len_dual);
+    }
+    mem_arena_scratch_end(MEM_ARENA_PSRAM);
+}
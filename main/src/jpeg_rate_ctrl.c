@@ -0,0 +1,93 @@
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "jpeg_encode.h"
+#include "jpeg_rate_ctrl.h"
+#include "usb_descriptors_override.h"
+
+static const char *TAG = "rate_ctrl";
+
+// Quality steps: big back-off when a frame overflowed, small probes upward
+#define RATE_CTRL_OVERFLOW_STEP     10
+#define RATE_CTRL_MAX_DOWN_STEP     8
+// Raise quality only while comfortably under budget (percent)
+#define RATE_CTRL_HEADROOM_PCT      85
+#define RATE_CTRL_ENCODE_HEADROOM_PCT  80
+
+static jpeg_rate_ctrl_state_t s_state = {
+    .quality = JPEG_ENCODE_DEFAULT_QUALITY,
+};
+static uint32_t s_frame_us = 0;
+
+static uint8_t clamp_quality(int q)
+{
+    if (q < CONFIG_WEBCAM_CHAN_JPEG_QUALITY_MIN) {
+        return CONFIG_WEBCAM_CHAN_JPEG_QUALITY_MIN;
+    }
+    if (q > CONFIG_WEBCAM_CHAN_JPEG_QUALITY_MAX) {
+        return CONFIG_WEBCAM_CHAN_JPEG_QUALITY_MAX;
+    }
+    return (uint8_t)q;
+}
+
+void jpeg_rate_ctrl_reset(size_t buf_capacity, uint32_t fps)
+{
+    uint32_t budget = CONFIG_WEBCAM_CHAN_JPEG_TARGET_BYTES;
+    if (buf_capacity > 0 && budget > buf_capacity) {
+        budget = (uint32_t)buf_capacity;
+    }
+    uint32_t drain = usb_desc_stream_bytes_per_frame(fps);
+    if (budget > drain) {
+        budget = drain;
+    }
+
+    s_state.quality = clamp_quality(JPEG_ENCODE_DEFAULT_QUALITY);
+    s_state.target_bytes = budget;
+    s_state.target_fps = fps;
+    s_state.bytes_avg = 0;
+    s_state.encode_us_avg = 0;
+    s_frame_us = (fps > 0) ? 1000000 / fps : 0;
+
+    ESP_LOGI(TAG, "target %lu B/frame @ %lu fps (usb drains %lu B/frame)",
+             (unsigned long)budget, (unsigned long)fps, (unsigned long)drain);
+}
+
+uint8_t jpeg_rate_ctrl_quality(void)
+{
+    return s_state.quality;
+}
+
+void jpeg_rate_ctrl_update(bool ok, size_t bytes, uint32_t encode_us)
+{
+    int q = s_state.quality;
+    uint32_t target = s_state.target_bytes;
+
+    if (!ok) {
+        s_state.quality = clamp_quality(q - RATE_CTRL_OVERFLOW_STEP);
+        return;
+    }
+
+    // Exponential averages with weight 1/4 for the newest frame
+    s_state.bytes_avg = s_state.bytes_avg ? (s_state.bytes_avg * 3 + (uint32_t)bytes) / 4
+                                          : (uint32_t)bytes;
+    s_state.encode_us_avg = s_state.encode_us_avg ? (s_state.encode_us_avg * 3 + encode_us) / 4
+                                                  : encode_us;
+
+    if (bytes > target) {
+        // Step down roughly in proportion to the overshoot (~2 per 10 %)
+        int step = (int)(((bytes - target) * 20) / target) + 1;
+        q -= (step > RATE_CTRL_MAX_DOWN_STEP) ? RATE_CTRL_MAX_DOWN_STEP : step;
+    } else if (s_frame_us > 0 && s_state.encode_us_avg > s_frame_us) {
+        // Encoder cannot keep up with the frame rate; fewer bits code faster
+        q -= 1;
+    } else if (s_state.bytes_avg * 100 < target * RATE_CTRL_HEADROOM_PCT &&
+               (s_frame_us == 0 ||
+                s_state.encode_us_avg * 100 < s_frame_us * RATE_CTRL_ENCODE_HEADROOM_PCT)) {
+        q += 1;
+    }
+    s_state.quality = clamp_quality(q);
+}
+
+void jpeg_rate_ctrl_get_state(jpeg_rate_ctrl_state_t *out)
+{
+    *out = s_state;
+}
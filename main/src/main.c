@@ -3,138 +3,167 @@
 #include "freertos/task.h"
 #include "esp_camera.h"
 #include "esp_timer.h"
-#include "esp_heap_caps.h"
-#include "img_converters.h"
+#include "esp_log.h"
 #include "bsp/esp-bsp.h"
 #include "lvgl.h"
 #include "usb_device_uvc.h"
 #include "camera_pins.h"
+#include "camera_ctrl.h"
+#include "frame_pipeline.h"
+#include "display_governor.h"
+#include "camera_preview.h"
+#include "usb_descriptors_override.h"
+#include "color_conv.h"
+#include "jpeg_encode.h"
+#include "dev_console.h"
 #include "uvc_ctrl_registry.h"
 #include "uvc_ctrl_params.h"
 #include "uvc_ctrl_state.h"
+#include "uvc_telemetry.h"
 #include "avatar.h"
+#include "mem_arena.h"
+#include "boot_status.h"
 
-// UVC Buffer size (must be larger than single frame)
-#define UVC_BUFFER_SIZE     (40 * 1024)
+// UVC Buffer size (must be larger than single frame, including YUY2 frames)
+#define UVC_BUFFER_SIZE     (160 * 1024)
+_Static_assert(UVC_BUFFER_SIZE >= USB_YUY2_MAX_FRAME_BYTES, "UVC buffer too small for YUY2");
+
+// Max time fb_get waits for the encoder to finish a frame
+#define UVC_FRAME_WAIT_MS   100
+
+// Captures tried for the first good frame at boot; each blocks until the
+// sensor delivers or esp_camera_fb_get times out
+#define CAMERA_BOOT_FRAME_TRIES  10
+
+// Boot-time init tasks, gone once their part is up
+#define BOOT_TASK_STACK     4096
+#define BOOT_TASK_PRIO      5
+
+static const char *TAG = "webcam_chan";
 
 // LVGL UI objects
 static lv_obj_t *camera_dot = NULL;
 
-static volatile int g_brightness = 128;
 static int current_brightness = -1;
 
+// ui_task wake-up reasons (task notification bits)
+#define UI_EVT_CONTROLS  (1u << 0)
+#define UI_EVT_STREAM    (1u << 1)
+
+static TaskHandle_t s_ui_task = NULL;
+
+static void ui_notify(uint32_t events)
+{
+    if (s_ui_task != NULL) {
+        xTaskNotify(s_ui_task, events, eSetBits);
+    }
+}
+
 static void uvc_ctrl_value_log(const char *name, int64_t value)
 {
+    // Values are already published in g_uvc_ctrl_state; just wake the
+    // consumers. The encoder task does the SCCB writes, off the USB context
+    frame_pipeline_wake();
     if (strcmp(name, "Brightness") == 0) {
-        if (value < 0) {
-            value = 0;
-        } else if (value > 255) {
-            value = 255;
-        }
-        g_brightness = (int)value;
+        ui_notify(UI_EVT_CONTROLS);
     }
 }
 
 // UVC streaming state
 static volatile bool uvc_streaming = false;
+static uvc_format_t uvc_stream_format = UVC_FORMAT_JPEG;
 static uint8_t *uvc_buffer = NULL;
-static uint8_t *jpeg_buffer = NULL;
-static size_t jpeg_buffer_size = 0;
 static uvc_fb_t uvc_frame;
 
-// Keep track of current camera frame for returning
-static camera_fb_t *current_camera_fb = NULL;
+// Keep track of the pipeline slot currently handed to USB
+static frame_slot_t *current_slot = NULL;
 
-static esp_err_t init_camera(void)
+#if CONFIG_WEBCAM_CHAN_SLICED_JPEG
+static size_t uvc_slice_poll(void *arg, bool *done, bool *failed)
 {
-    camera_config_t config = BSP_CAMERA_DEFAULT_CONFIG;
-
-    config.pixel_format = PIXFORMAT_RGB565;
-    config.frame_size = FRAMESIZE_QVGA;
-    config.fb_count = 2;
-    config.fb_location = CAMERA_FB_IN_PSRAM;
-    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
-
-    esp_err_t err = esp_camera_init(&config);
-    if (err != ESP_OK) {
-        return err;
-    }
-
-    sensor_t *s = esp_camera_sensor_get();
-    if (s != NULL) {
-        s->set_vflip(s, BSP_CAMERA_VFLIP);
-        s->set_hmirror(s, BSP_CAMERA_HMIRROR);
-    }
-    return ESP_OK;
+    frame_live_t state;
+    uint32_t len = frame_pipeline_live_progress((frame_slot_t *)arg, &state);
+    *done = (state == FRAME_LIVE_DONE);
+    *failed = (state == FRAME_LIVE_FAILED);
+    return len;
 }
 
+// The sliced frame is on the wire: the slot can be reused
+static void uvc_slice_done(void *arg)
+{
+    frame_pipeline_release((frame_slot_t *)arg);
+}
+#endif
 
 static esp_err_t uvc_input_start_cb(uvc_format_t format, int width, int height, int rate, void *cb_ctx)
 {
+    // Sensor reconfiguration happens on the encoder task, not in USB context
+    uint16_t yuy2_width = 0;
+    uint16_t yuy2_height = 0;
+    uint32_t yuy2_fps = 0;
+
+    uvc_stream_format = format;
     uvc_streaming = true;
+    ui_notify(UI_EVT_STREAM);
+    if (usb_desc_committed_yuy2(&yuy2_width, &yuy2_height, &yuy2_fps)) {
+        frame_pipeline_start(FRAME_FORMAT_YUY2, yuy2_width, yuy2_height, yuy2_fps);
+    } else {
+        frame_pipeline_start(FRAME_FORMAT_MJPEG, (uint16_t)width, (uint16_t)height, (uint32_t)rate);
+    }
     return ESP_OK;
 }
 
-// Callback to get frame buffer from camera
-// Captures RGB565 frame and converts to JPEG for USB streaming
+// Callback to get frame buffer for USB streaming
+// Picks up the newest JPEG frame finished by the encoder task
 static uvc_fb_t *uvc_input_fb_get_cb(void *cb_ctx)
 {
+#if CONFIG_WEBCAM_CHAN_SLICED_JPEG
+    // usb_device_uvc comes back here only once the last frame is done, so
+    // a sliced frame still waiting to be queued was dropped
+    usb_desc_slices_drop_pending();
+#endif
     if (!uvc_streaming) {
         return NULL;
     }
 
-    camera_fb_t *fb = NULL;
-    for (int retry = 0; retry < 3; retry++) {
-        fb = esp_camera_fb_get();
-        if (fb != NULL) {
-            break;
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-
-    if (fb == NULL) {
+    frame_slot_t *slot = frame_pipeline_acquire(pdMS_TO_TICKS(UVC_FRAME_WAIT_MS));
+    if (slot == NULL) {
         return NULL;
     }
 
-    current_camera_fb = fb;
-
-    // Convert RGB565 to JPEG (frame2jpg allocates buffer internally)
-    uint8_t *out_buf = NULL;
-    size_t out_len = 0;
-    bool converted = frame2jpg(fb, 80, &out_buf, &out_len);
-
-    if (!converted || out_buf == NULL || out_len == 0) {
-        esp_camera_fb_return(fb);
-        current_camera_fb = NULL;
-        return NULL;
+    current_slot = slot;
+
+    // Fill UVC frame structure (zero-copy in sensor JPEG mode)
+    uvc_frame.buf = slot->data;
+    uvc_frame.len = slot->len;
+    uvc_frame.width = slot->width;
+    uvc_frame.height = slot->height;
+    uvc_frame.format = uvc_stream_format;
+    uvc_frame.timestamp = slot->timestamp;
+    usb_desc_set_frame_capture_time((int64_t)slot->timestamp.tv_sec * 1000000 + slot->timestamp.tv_usec);
+    frame_trace_stamp(&slot->trace, FRAME_TRACE_HANDOFF);
+#if CONFIG_WEBCAM_CHAN_SLICED_JPEG
+    if (slot->live != FRAME_LIVE_NONE) {
+        // Still being encoded: the override sends it from slot->data as it
+        // grows and only the bytes final so far go through uvc_buffer
+        frame_live_t state;
+        uvc_frame.len = frame_pipeline_live_progress(slot, &state);
+        usb_desc_stream_sliced(slot->data, uvc_slice_poll, uvc_slice_done, slot);
     }
-
-    jpeg_buffer = out_buf;
-    jpeg_buffer_size = out_len;
-
-    // Fill UVC frame structure with JPEG data
-    uvc_frame.buf = jpeg_buffer;
-    uvc_frame.len = jpeg_buffer_size;
-    uvc_frame.width = fb->width;
-    uvc_frame.height = fb->height;
-    uvc_frame.format = UVC_FORMAT_JPEG;
-    uvc_frame.timestamp = fb->timestamp;
+#endif
 
     return &uvc_frame;
 }
 
-// Callback to return frame buffer to camera
+// Callback to return frame buffer to the pipeline
 static void uvc_input_fb_return_cb(uvc_fb_t *fb, void *cb_ctx)
 {
-    if (jpeg_buffer != NULL) {
-        free(jpeg_buffer);
-        jpeg_buffer = NULL;
-        jpeg_buffer_size = 0;
-    }
-
-    if (current_camera_fb != NULL) {
-        esp_camera_fb_return(current_camera_fb);
-        current_camera_fb = NULL;
+    if (current_slot != NULL) {
+        // A sliced frame is released by uvc_slice_done once it is sent
+        if (current_slot->live == FRAME_LIVE_NONE) {
+            frame_pipeline_release(current_slot);
+        }
+        current_slot = NULL;
     }
 }
 
@@ -142,28 +171,27 @@ static void uvc_input_fb_return_cb(uvc_fb_t *fb, void *cb_ctx)
 static void uvc_input_stop_cb(void *cb_ctx)
 {
     uvc_streaming = false;
-
-    if (jpeg_buffer != NULL) {
-        free(jpeg_buffer);
-        jpeg_buffer = NULL;
-        jpeg_buffer_size = 0;
-    }
-
-    if (current_camera_fb != NULL) {
-        esp_camera_fb_return(current_camera_fb);
-        current_camera_fb = NULL;
-    }
+    current_slot = NULL;
+    frame_pipeline_stop();
+    ui_notify(UI_EVT_STREAM);
 }
 
 static esp_err_t init_usb_uvc(void)
 {
-    uvc_buffer = heap_caps_malloc(UVC_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (uvc_buffer == NULL) {
-        uvc_buffer = heap_caps_malloc(UVC_BUFFER_SIZE, MALLOC_CAP_DEFAULT);
-        if (uvc_buffer == NULL) {
-            return ESP_ERR_NO_MEM;
-        }
+    uvc_buffer = mem_arena_alloc(MEM_ARENA_PSRAM, UVC_BUFFER_SIZE, 16, "uvc transfer");
+
+    // Output pool: one fixed buffer per pipeline slot
+    frame_pipeline_alloc_buffers(UVC_BUFFER_SIZE);
+    jpeg_encode_alloc_buffers(UVC_BUFFER_SIZE);
+    esp_err_t err;
+
+#if CONFIG_WEBCAM_CHAN_SLICED_JPEG
+    err = usb_desc_slices_init();
+    if (err != ESP_OK) {
+        return err;
     }
+    frame_pipeline_set_slice_listener(usb_desc_slice_kick, usb_desc_slices_abort);
+#endif
 
     // UVC device configuration
     uvc_device_config_t uvc_config = {
@@ -176,7 +204,7 @@ static esp_err_t init_usb_uvc(void)
         .cb_ctx = NULL,
     };
 
-    esp_err_t err = uvc_device_config(0, &uvc_config);
+    err = uvc_device_config(0, &uvc_config);
     if (err != ESP_OK) {
         return err;
     }
@@ -195,6 +223,7 @@ static void create_ui(void)
     lv_obj_set_style_bg_color(lv_scr_act(), lv_color_hex(0x000000), 0);
 
     stackchanface_init(lv_scr_act());
+    camera_preview_init(lv_scr_act());
 
     camera_dot = lv_obj_create(lv_scr_act());
     lv_obj_set_size(camera_dot, 8, 8);
@@ -212,13 +241,19 @@ static void create_ui(void)
 
 /**
  * UI update task
+ *
+ * Sleeps until a control changes or streaming starts/stops (task
+ * notification), or until the next blink while streaming.
  */
 static void ui_task(void *arg)
 {
     static bool blink_on = false;
     static int64_t last_blink_time = 0;
+    uint32_t events = UI_EVT_CONTROLS;
 
     for (;;) {
+        TickType_t wait = portMAX_DELAY;
+
         // Blink red dot while camera is streaming (1Hz)
         if (uvc_streaming) {
             int64_t now = esp_timer_get_time();
@@ -233,6 +268,8 @@ static void ui_task(void *arg)
                 }
                 bsp_display_unlock();
             }
+            int64_t next_us = last_blink_time + 500000 - now;
+            wait = pdMS_TO_TICKS((next_us > 0 ? next_us : 0) / 1000) + 1;
         } else {
             if (blink_on) {
                 blink_on = false;
@@ -243,58 +280,141 @@ static void ui_task(void *arg)
             last_blink_time = 0;
         }
 
-        // Update avatar eye shape based on UVC gain control
-        int pending = g_brightness;
-        if (pending >= 0 && pending <= 255 && pending != current_brightness) {
-            current_brightness = pending;
+        if (events & UI_EVT_STREAM) {
             bsp_display_lock(0);
-            stackchanface_set_brightness((uint8_t)pending);
+            display_governor_set_streaming(uvc_streaming);
             bsp_display_unlock();
         }
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+        // Update avatar eye shape based on the UVC brightness control
+        if (events & UI_EVT_CONTROLS) {
+            uvc_ctrl_state_t ctrl;
+            uvc_ctrl_state_snapshot(&ctrl);
+            int pending = (int)ctrl.brightness;
+            if (pending >= 0 && pending <= 255 && pending != current_brightness) {
+                current_brightness = pending;
+                bsp_display_lock(0);
+                stackchanface_set_brightness((uint8_t)pending);
+                bsp_display_unlock();
+            }
+        }
+
+        events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, wait);
     }
 }
 
-void app_main(void)
+// Bring up the LCD and build the UI while the camera and USB start
+static void display_init_task(void *arg)
 {
     bsp_display_start();
     bsp_display_backlight_on();
     bsp_display_brightness_set(80);
 
     create_ui();
+    boot_status_mark(BOOT_STAGE_DISPLAY);
+    vTaskDelete(NULL);
+}
 
-    // Register UVC control parameters
-    uvc_ctrl_registry_register(g_uvc_ctrl_entries, g_uvc_ctrl_entry_count);
-    uvc_ctrl_state_set_callback(uvc_ctrl_value_log);
+#if CONFIG_WEBCAM_CHAN_JPEG_BOOT_BENCH
+// Runs in place of the encoder task, on its core and at its priority, so
+// the two-band timing overlaps with the band task on the other core. The
+// camera is borrowed from the idle pipeline, and the benchmark is skipped
+// when the host is already streaming
+static void boot_bench_task(void *arg)
+{
+    if (frame_pipeline_borrow_camera(0)) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb != NULL) {
+            jpeg_encode_benchmark(fb);
+            esp_camera_fb_return(fb);
+        }
+        frame_pipeline_return_camera();
+    }
+
+    // Budget table, now including the benchmark scratch
+    mem_arena_report();
+    vTaskDelete(NULL);
+}
+#endif
 
-    // Initialize camera
-    esp_err_t err = init_camera();
+// Start the sensor and wait for its first good frame; capture blocks until
+// the sensor delivers, so no settle delays are needed
+static void camera_init_task(void *arg)
+{
+    esp_err_t err = camera_ctrl_init();
     if (err != ESP_OK) {
-        while (1) {
-            vTaskDelay(pdMS_TO_TICKS(1000));
-        }
+        ESP_LOGE(TAG, "camera init failed: %s", esp_err_to_name(err));
+        vTaskDelete(NULL);
     }
-    // Wait for camera to start capturing
-    vTaskDelay(pdMS_TO_TICKS(500));
 
-    // Test camera capture before starting UVC (with retries)
     camera_fb_t *test_fb = NULL;
-    for (int i = 0; i < 10; i++) {
+    for (int i = 0; i < CAMERA_BOOT_FRAME_TRIES && test_fb == NULL; i++) {
         test_fb = esp_camera_fb_get();
-        if (test_fb) {
-            break;
+        if (test_fb != NULL && test_fb->len == 0) {
+            esp_camera_fb_return(test_fb);
+            test_fb = NULL;
         }
-        vTaskDelay(pdMS_TO_TICKS(200));
     }
+    if (test_fb == NULL) {
+        ESP_LOGE(TAG, "no frame from the camera");
+        vTaskDelete(NULL);
+    }
+    boot_status_mark(BOOT_STAGE_FIRST_FRAME);
+    esp_camera_fb_return(test_fb);
+    boot_status_mark(BOOT_STAGE_CAMERA);
+
+#if CONFIG_WEBCAM_CHAN_JPEG_BOOT_BENCH
+    // Only once streams may start, so readiness never waits for it; this
+    // task is on core 0 with the band task, so the benchmark gets its own
+    if (xTaskCreatePinnedToCore(boot_bench_task, "boot_bench", BOOT_TASK_STACK, NULL,
+                                FRAME_PIPELINE_TASK_PRIO, NULL, FRAME_PIPELINE_TASK_CORE) != pdPASS) {
+        ESP_LOGW(TAG, "no memory for the boot benchmark");
+        mem_arena_report();
+    }
+#else
+    // Budget table: every region is fully carved by now
+    mem_arena_report();
+#endif
+    vTaskDelete(NULL);
+}
 
-    if (test_fb) {
-        esp_camera_fb_return(test_fb);
+void app_main(void)
+{
+    // Reserve the memory plan before anything else takes the heap; aborts
+    // here if the configured regions do not fit
+    static const size_t arena_capacity[MEM_ARENA_REGION_COUNT] = {
+        [MEM_ARENA_SRAM_DMA] = CONFIG_WEBCAM_CHAN_ARENA_SRAM_KB * 1024,
+        [MEM_ARENA_PSRAM] = CONFIG_WEBCAM_CHAN_ARENA_PSRAM_KB * 1024,
+    };
+    mem_arena_init(arena_capacity);
+    boot_status_init();
+
+    // Verify the SIMD color conversion kernel; falls back to scalar on mismatch
+    if (!color_conv_selftest()) {
+        ESP_LOGW(TAG, "SIMD RGB565->YUYV kernel mismatch, using scalar path");
     }
+    jpeg_encode_init();
 
-    // Small delay to ensure camera is stable
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // Register UVC control parameters
+    uvc_ctrl_registry_register(g_uvc_ctrl_entries, g_uvc_ctrl_entry_count);
+    uvc_ctrl_registry_register(g_uvc_telemetry_entries, g_uvc_telemetry_entry_count);
+    uvc_ctrl_state_set_callback(uvc_ctrl_value_log);
+
+    // Shared I2C bus and camera power, before the display and camera tasks
+    // both reach for the power expander
+    ESP_ERROR_CHECK(bsp_feature_enable(BSP_FEATURE_CAMERA, true));
+
+    esp_err_t err = frame_pipeline_init();
+    if (err != ESP_OK) {
+        while (1) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+    }
 
+    // Enumerate right away; stream commits report "not ready" until the
+    // camera is up. Every arena region is carved here, before the init
+    // tasks run
     err = init_usb_uvc();
     if (err != ESP_OK) {
         while (1) {
@@ -302,8 +422,26 @@ void app_main(void)
         }
     }
 
+    xTaskCreatePinnedToCore(display_init_task, "display_init", BOOT_TASK_STACK, NULL,
+                            BOOT_TASK_PRIO, NULL, 1);
+    xTaskCreatePinnedToCore(camera_init_task, "camera_init", BOOT_TASK_STACK, NULL,
+                            BOOT_TASK_PRIO, NULL, 0);
+
+    boot_status_wait(BOOT_STAGE_BIT(BOOT_STAGE_DISPLAY), portMAX_DELAY);
+
     // Start UI update task
-    xTaskCreatePinnedToCore(ui_task, "ui_task", 4096, NULL, 3, NULL, 1);
+    xTaskCreatePinnedToCore(ui_task, "ui_task", 4096, NULL, 3, &s_ui_task, 1);
+
+#if CONFIG_WEBCAM_CHAN_DEV_CONSOLE
+    dev_console_start();
+#endif
+
+    // Blocks for good if the camera never comes up; USB then keeps
+    // answering "not ready"
+    boot_status_wait(BOOT_STAGE_BIT(BOOT_STAGE_CAMERA), portMAX_DELAY);
+    frame_pipeline_set_ready(camera_ctrl_sensor_jpeg() ? FRAME_PIPELINE_SENSOR_JPEG
+                                                        : FRAME_PIPELINE_SW_JPEG);
+    usb_desc_set_stream_ready(true);
 
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(1000));
@@ -2,21 +2,40 @@
  * Override the USB configuration descriptor to include a Processing Unit
  * in the UVC Video Control interface topology, and intercept
  * videod_control_xfer_cb to handle entity control requests that TinyUSB's
- * built-in video driver does not support.
+ * built-in video driver does not support. The descriptor also adds a
+ * telemetry Extension Unit and an uncompressed YUY2 streaming format next
+ * to MJPEG.
  *
  * Original topology:  Camera Terminal (0x01) -> Output Terminal (0x02)
- * New topology:       Camera Terminal (0x01) -> Processing Unit (0x02) -> Output Terminal (0x03)
+ * New topology:       Camera Terminal (0x01) -> Processing Unit (0x02) ->
+ *                     Extension Unit (0x04) -> Output Terminal (0x03)
  *
- * Uses the linker --wrap option to intercept tud_descriptor_configuration_cb
- * and videod_control_xfer_cb without modifying managed_components.
+ * The video data endpoint is isochronous by default. With
+ * CONFIG_UVC_MODE_BULK_CAM1 the streaming interface instead carries a bulk
+ * endpoint on alternate setting 0 and has no alternate setting 1 (UVC 1.5,
+ * 2.4.3): streaming starts on VS_COMMIT rather than on SET_INTERFACE.
+ *
+ * Uses the linker --wrap option to intercept tud_descriptor_configuration_cb,
+ * videod_control_xfer_cb, tud_video_commit_cb, tud_video_n_frame_xfer,
+ * tud_video_frame_xfer_complete_cb, usbd_edpt_xfer and tud_mount_cb without
+ * modifying managed_components.
  */
 
 #include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "soc/soc.h"
 #include "tusb.h"
+#include "device/usbd_pvt.h"
 #include "class/video/video.h"
 #include "usb_descriptors.h"
 #include "uvc_ctrl_registry.h"
 #include "uvc_ctrl_params.h"
+#include "uvc_telemetry.h"
+#include "usb_descriptors_override.h"
+#include "camera_ctrl.h"
+#include "boot_status.h"
 
 /* ======================================================================
  * Part 1: Configuration Descriptor with Processing Unit
@@ -31,15 +50,32 @@
  */
 #define PU_DESC_LEN  13
 
+/* Extension Unit descriptor (UVC 1.5, 3.7.2.7) for the telemetry controls,
+ * one input pin, bControlSize=2
+ *
+ * Fields:
+ *   bLength(1) + bDescriptorType(1) + bDescriptorSubtype(1) + bUnitID(1) +
+ *   guidExtensionCode(16) + bNumControls(1) + bNrInPins(1) + baSourceID(1) +
+ *   bControlSize(1) + bmControls(2) + iExtension(1) = 27
+ */
+#define XU_DESC_LEN  27
+
+#define TUD_VIDEO_DESC_EXTENSION_UNIT(_unitID, _srcID, _numControls, _bm) \
+    XU_DESC_LEN, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VC_EXTENSION_UNIT, \
+    _unitID, UVC_TELEMETRY_GUID, _numControls, 0x01, _srcID, \
+    0x02, U16_TO_U8S_LE(_bm), 0x00
+
 /*
- * bmControls bitmap for Processing Unit:
- *   Byte 0 bits: [0]Brightness [1]Contrast [2]Hue [3]Saturation
- *   Byte 1 bits: [3]HueAuto [4]WhiteBalanceTempAuto
- *   Byte 2: unused
+ * bmControls bitmaps for the Camera Terminal and Processing Unit, generated
+ * from UVC_CTRL_PARAM_LIST so the descriptor always advertises exactly the
+ * controls the registry answers.
  */
-#define PU_BM_CTRL_0  0x0F
-#define PU_BM_CTRL_1  0x18
-#define PU_BM_CTRL_2  0x00
+_Static_assert((UVC_CTRL_CT_BM_CONTROLS & ~0xFFFFFFUL) == 0, "CT control without a bmControls bit");
+_Static_assert((UVC_CTRL_PU_BM_CONTROLS & ~0xFFFFFFUL) == 0, "PU control without a bmControls bit");
+
+#define PU_BM_CTRL_0  ((uint8_t)(UVC_CTRL_PU_BM_CONTROLS & 0xFF))
+#define PU_BM_CTRL_1  ((uint8_t)((UVC_CTRL_PU_BM_CONTROLS >> 8) & 0xFF))
+#define PU_BM_CTRL_2  ((uint8_t)((UVC_CTRL_PU_BM_CONTROLS >> 16) & 0xFF))
 
 #define TUD_VIDEO_DESC_PROCESSING_UNIT(_unitID, _srcID, _bm0, _bm1, _bm2) \
     PU_DESC_LEN, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VC_PROCESSING_UNIT, \
@@ -47,9 +83,106 @@
     0x03, _bm0, _bm1, _bm2, \
     0x00, 0x00
 
-/* Total configuration descriptor length = original + Processing Unit */
+#ifndef TUD_VIDEO_DESC_STD_VS_LEN
+#define TUD_VIDEO_DESC_STD_VS_LEN  9
+#endif
+#ifndef TUD_VIDEO_DESC_EP_BULK
+#define TUD_VIDEO_DESC_EP_BULK(_epin, _epsize, _ep_interval) \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), _ep_interval
+#endif
+
+// Payload header with PTS and SCR (Part 4)
+#define PAYLOAD_HDR_LEN             12
+
+/*
+ * Payload bytes the streaming endpoint can drain per 1 ms USB frame.
+ *
+ * ISO: one reserved CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE packet per
+ * frame, less its payload header, guaranteed whatever else is on the bus.
+ * Bulk: no reservation, but on an otherwise idle full-speed bus up to 19
+ * 64-byte packets fit in a frame (USB 2.0, 5.8.4). The payload header is
+ * paid once per payload transfer rather than per packet, so it is ignored.
+ */
+#if CONFIG_UVC_MODE_BULK_CAM1
+#define STREAM_EP_SIZE              64
+#define STREAM_PAYLOAD_BYTES_PER_MS (19 * STREAM_EP_SIZE)
+#else
+#define STREAM_EP_SIZE              CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE
+#define STREAM_PAYLOAD_BYTES_PER_MS (CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE - PAYLOAD_HDR_LEN)
+#endif
+
+/*
+ * Uncompressed YUY2 format (format index 2).
+ *
+ * Frame rates are limited by what the streaming endpoint can drain.
+ */
+#define YUY2_FRAME_NUM  2
+
+#define YUY2_FRAME_BYTES(_w, _h)  ((_w) * (_h) * 2)
+#define YUY2_FPS_RAW(_w, _h) \
+    ((STREAM_PAYLOAD_BYTES_PER_MS * 1000) / YUY2_FRAME_BYTES(_w, _h))
+#define YUY2_FPS(_w, _h)  ((YUY2_FPS_RAW(_w, _h) > 0) ? YUY2_FPS_RAW(_w, _h) : 1)
+#define YUY2_INTERVAL(_w, _h)  (10000000 / YUY2_FPS(_w, _h))
+
+#define TUD_VIDEO_DESC_CS_VS_FRM_YUY2(_frmidx, _w, _h) \
+    TUD_VIDEO_DESC_CS_VS_FRM_UNCOMPR_CONT( \
+        _frmidx, 0, _w, _h, \
+        YUY2_FRAME_BYTES(_w, _h) * 8, \
+        YUY2_FRAME_BYTES(_w, _h) * 8 * YUY2_FPS(_w, _h), \
+        YUY2_FRAME_BYTES(_w, _h), \
+        YUY2_INTERVAL(_w, _h), \
+        YUY2_INTERVAL(_w, _h), \
+        YUY2_INTERVAL(_w, _h) * YUY2_FPS(_w, _h), \
+        YUY2_INTERVAL(_w, _h))
+
+/* VS descriptors added for YUY2, plus one bmaControls byte in the input header */
+#define YUY2_DESC_LEN \
+    (TUD_VIDEO_DESC_CS_VS_FMT_UNCOMPR_LEN \
+     + (YUY2_FRAME_NUM * TUD_VIDEO_DESC_CS_VS_FRM_UNCOMPR_CONT_LEN) \
+     + TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING_LEN)
+
+/* Total configuration descriptor length = original + Processing Unit +
+ * Extension Unit + YUY2, less the alternate setting 1 interface descriptor
+ * in bulk mode */
+#if CONFIG_UVC_MODE_BULK_CAM1
+#define STREAM_ALT_LEN  0
+#else
+#define STREAM_ALT_LEN  TUD_VIDEO_DESC_STD_VS_LEN
+#endif
+
 #define MY_CONFIG_TOTAL_LEN \
-    (TUD_CONFIG_DESC_LEN + TUD_VIDEO_CAPTURE_DESC_MULTI_MJPEG_LEN(4) + PU_DESC_LEN)
+    (TUD_CONFIG_DESC_LEN + TUD_VIDEO_CAPTURE_DESC_MULTI_MJPEG_LEN(4) + PU_DESC_LEN + XU_DESC_LEN \
+     + 1 + YUY2_DESC_LEN - TUD_VIDEO_DESC_STD_VS_LEN + STREAM_ALT_LEN)
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+} frame_size_t;
+
+static const frame_size_t s_yuy2_frames[YUY2_FRAME_NUM] = {
+    { USB_YUY2_FRAME_1_WIDTH, USB_YUY2_FRAME_1_HEIGHT },
+    { USB_YUY2_FRAME_2_WIDTH, USB_YUY2_FRAME_2_HEIGHT },
+};
+
+/* MJPEG frames in the order usb_device_uvc advertises them (sdkconfig) */
+#define MJPEG_FRAME_NUM  4
+_Static_assert(UVC_FRAME_NUM == MJPEG_FRAME_NUM, "MJPEG frame table out of sync with sdkconfig");
+
+static const frame_size_t s_mjpeg_frames[MJPEG_FRAME_NUM] = {
+    { CONFIG_UVC_CAM1_FRAMESIZE_WIDTH, CONFIG_UVC_CAM1_FRAMESIZE_HEIGT },
+    { CONFIG_UVC_MULTI_FRAME_WIDTH_1, CONFIG_UVC_MULTI_FRAME_HEIGHT_1 },
+    { CONFIG_UVC_MULTI_FRAME_WIDTH_2, CONFIG_UVC_MULTI_FRAME_HEIGHT_2 },
+    { CONFIG_UVC_MULTI_FRAME_WIDTH_3, CONFIG_UVC_MULTI_FRAME_HEIGHT_3 },
+};
+
+/* Advertise only sizes the sensor outputs natively; nothing is scaled */
+#define FRAME_FITS_SENSOR(_w, _h)  ((_w) <= USB_SENSOR_MAX_WIDTH && (_h) <= USB_SENSOR_MAX_HEIGHT)
+_Static_assert(FRAME_FITS_SENSOR(CONFIG_UVC_CAM1_FRAMESIZE_WIDTH, CONFIG_UVC_CAM1_FRAMESIZE_HEIGT) &&
+               FRAME_FITS_SENSOR(CONFIG_UVC_MULTI_FRAME_WIDTH_1, CONFIG_UVC_MULTI_FRAME_HEIGHT_1) &&
+               FRAME_FITS_SENSOR(CONFIG_UVC_MULTI_FRAME_WIDTH_2, CONFIG_UVC_MULTI_FRAME_HEIGHT_2) &&
+               FRAME_FITS_SENSOR(CONFIG_UVC_MULTI_FRAME_WIDTH_3, CONFIG_UVC_MULTI_FRAME_HEIGHT_3) &&
+               FRAME_FITS_SENSOR(USB_YUY2_FRAME_2_WIDTH, USB_YUY2_FRAME_2_HEIGHT),
+               "advertised frame size beyond the sensor maximum");
 
 #define MY_EPNUM_VIDEO_IN  0x81
 
@@ -62,31 +195,41 @@ static uint8_t const my_desc_fs_configuration[] = {
     TUD_VIDEO_DESC_STD_VC(ITF_NUM_VIDEO_CONTROL, 0, 4),
     TUD_VIDEO_DESC_CS_VC(
         0x0150,
-        TUD_VIDEO_DESC_CAMERA_TERM_LEN + PU_DESC_LEN + TUD_VIDEO_DESC_OUTPUT_TERM_LEN,
+        TUD_VIDEO_DESC_CAMERA_TERM_LEN + PU_DESC_LEN + XU_DESC_LEN + TUD_VIDEO_DESC_OUTPUT_TERM_LEN,
         UVC_CLOCK_FREQUENCY,
         ITF_NUM_VIDEO_STREAMING),
     /* Camera Terminal (entity 1) */
-    TUD_VIDEO_DESC_CAMERA_TERM(UVC_ENTITY_ID_CAMERA_TERMINAL, 0, 0, 0, 0, 0, 0),
+    TUD_VIDEO_DESC_CAMERA_TERM(UVC_ENTITY_ID_CAMERA_TERMINAL, 0, 0, 0, 0, 0,
+                               UVC_CTRL_CT_BM_CONTROLS),
     /* Processing Unit (entity 2), source = Camera Terminal */
     TUD_VIDEO_DESC_PROCESSING_UNIT(
         UVC_ENTITY_ID_PROCESSING_UNIT, UVC_ENTITY_ID_CAMERA_TERMINAL,
         PU_BM_CTRL_0, PU_BM_CTRL_1, PU_BM_CTRL_2),
-    /* Output Terminal (entity 3), source = Processing Unit */
+    /* Telemetry Extension Unit (entity 4), source = Processing Unit */
+    TUD_VIDEO_DESC_EXTENSION_UNIT(
+        UVC_ENTITY_ID_EXTENSION_UNIT, UVC_ENTITY_ID_PROCESSING_UNIT,
+        UVC_XU_TELEMETRY_CONTROL_COUNT, UVC_XU_TELEMETRY_BM_CONTROLS),
+    /* Output Terminal (entity 3), source = Extension Unit */
     TUD_VIDEO_DESC_OUTPUT_TERM(
         UVC_ENTITY_ID_OUTPUT_TERMINAL, VIDEO_TT_STREAMING, 0,
-        UVC_ENTITY_ID_PROCESSING_UNIT, 0),
+        UVC_ENTITY_ID_EXTENSION_UNIT, 0),
 
-    /* ---- Video Streaming Interface (alt 0) ---- */
+    /* ---- Video Streaming Interface (alt 0), with the bulk endpoint in bulk mode ---- */
+#if CONFIG_UVC_MODE_BULK_CAM1
+    TUD_VIDEO_DESC_STD_VS(ITF_NUM_VIDEO_STREAMING, 0, 1, 4),
+#else
     TUD_VIDEO_DESC_STD_VS(ITF_NUM_VIDEO_STREAMING, 0, 0, 4),
+#endif
     TUD_VIDEO_DESC_CS_VS_INPUT(
-        1,
+        2,
         TUD_VIDEO_DESC_CS_VS_FMT_MJPEG_LEN
             + (UVC_FRAME_NUM * TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_CONT_LEN)
-            + TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING_LEN,
+            + TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING_LEN
+            + YUY2_DESC_LEN,
         MY_EPNUM_VIDEO_IN, 0,
         UVC_ENTITY_ID_OUTPUT_TERMINAL,
         0, 0, 0,
-        0),
+        0, 0),
     TUD_VIDEO_DESC_CS_VS_FMT_MJPEG(
         1, UVC_FRAME_NUM, 0, 1, 0, 0, 0, 0),
     TUD_VIDEO_DESC_CS_VS_FRM_MJPEG_CONT_TEMPLATE(0, 1),
@@ -98,9 +241,23 @@ static uint8_t const my_desc_fs_configuration[] = {
         VIDEO_COLOR_XFER_CH_BT709,
         VIDEO_COLOR_COEF_SMPTE170M),
 
+    /* YUY2 format + frames */
+    TUD_VIDEO_DESC_CS_VS_FMT_YUY2(
+        USB_FORMAT_INDEX_YUY2, YUY2_FRAME_NUM, 1, 0, 0, 0, 0),
+    TUD_VIDEO_DESC_CS_VS_FRM_YUY2(1, USB_YUY2_FRAME_1_WIDTH, USB_YUY2_FRAME_1_HEIGHT),
+    TUD_VIDEO_DESC_CS_VS_FRM_YUY2(2, USB_YUY2_FRAME_2_WIDTH, USB_YUY2_FRAME_2_HEIGHT),
+    TUD_VIDEO_DESC_CS_VS_COLOR_MATCHING(
+        VIDEO_COLOR_PRIMARIES_BT709,
+        VIDEO_COLOR_XFER_CH_BT709,
+        VIDEO_COLOR_COEF_SMPTE170M),
+
+#if CONFIG_UVC_MODE_BULK_CAM1
+    TUD_VIDEO_DESC_EP_BULK(MY_EPNUM_VIDEO_IN, STREAM_EP_SIZE, 1),
+#else
     /* ---- Video Streaming Interface (alt 1) + ISO Endpoint ---- */
     TUD_VIDEO_DESC_STD_VS(ITF_NUM_VIDEO_STREAMING, 1, 1, 4),
-    TUD_VIDEO_DESC_EP_ISO(MY_EPNUM_VIDEO_IN, CFG_TUD_CAM1_VIDEO_STREAMING_EP_BUFSIZE, 1),
+    TUD_VIDEO_DESC_EP_ISO(MY_EPNUM_VIDEO_IN, STREAM_EP_SIZE, 1),
+#endif
 };
 
 _Static_assert(sizeof(my_desc_fs_configuration) == MY_CONFIG_TOTAL_LEN,
@@ -119,7 +276,8 @@ uint8_t const *__wrap_tud_descriptor_configuration_cb(uint8_t index)
  * (entity_id != 0). It only verifies the entity exists in the descriptor
  * and returns success without completing the USB control transfer,
  * causing a timeout. We intercept videod_control_xfer_cb to handle
- * Processing Unit control requests properly.
+ * Camera Terminal, Processing Unit and Extension Unit control requests
+ * properly.
  * ====================================================================== */
 
 extern bool __real_videod_control_xfer_cb(uint8_t rhport, uint8_t stage,
@@ -186,3 +344,385 @@ bool __wrap_videod_control_xfer_cb(uint8_t rhport, uint8_t stage,
     }
     return __real_videod_control_xfer_cb(rhport, stage, request);
 }
+
+/* ======================================================================
+ * Part 3: Committed streaming format
+ *
+ * usb_device_uvc maps bFrameIndex onto its MJPEG frame table only, so the
+ * commit is intercepted to remember which format the host actually chose.
+ * Until the camera delivers frames the commit is refused with "not ready",
+ * so a host that opens the device early retries instead of waiting on an
+ * empty stream. A frame size the detected sensor cannot output is refused
+ * as out of range rather than streamed at another size.
+ * ====================================================================== */
+
+extern int __real_tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
+                                      video_probe_and_commit_control_t const *parameters);
+
+static volatile uint8_t s_committed_format = USB_FORMAT_INDEX_MJPEG;
+static volatile uint8_t s_committed_frame = 1;
+static volatile uint32_t s_committed_interval = 0;
+static volatile bool s_stream_ready = false;
+
+static const frame_size_t *committed_frame_size(uint8_t format, uint8_t frame)
+{
+    if (format == USB_FORMAT_INDEX_MJPEG && frame >= 1 && frame <= MJPEG_FRAME_NUM) {
+        return &s_mjpeg_frames[frame - 1];
+    }
+    if (format == USB_FORMAT_INDEX_YUY2 && frame >= 1 && frame <= YUY2_FRAME_NUM) {
+        return &s_yuy2_frames[frame - 1];
+    }
+    return NULL;
+}
+
+int __wrap_tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
+                               video_probe_and_commit_control_t const *parameters)
+{
+    if (!s_stream_ready) {
+        return VIDEO_ERROR_NOT_READY;
+    }
+    const frame_size_t *size = committed_frame_size(parameters->bFormatIndex, parameters->bFrameIndex);
+    if (size == NULL || !camera_ctrl_frame_size_supported(size->width, size->height)) {
+        return VIDEO_ERROR_OUT_OF_RANGE;
+    }
+    s_committed_format = parameters->bFormatIndex;
+    s_committed_frame = parameters->bFrameIndex;
+    s_committed_interval = parameters->dwFrameInterval;
+    return __real_tud_video_commit_cb(ctl_idx, stm_idx, parameters);
+}
+
+void usb_desc_set_stream_ready(bool ready)
+{
+    s_stream_ready = ready;
+}
+
+bool usb_desc_committed_yuy2(uint16_t *width, uint16_t *height, uint32_t *fps)
+{
+    uint8_t frame = s_committed_frame;
+    if (s_committed_format != USB_FORMAT_INDEX_YUY2 ||
+        frame < 1 || frame > YUY2_FRAME_NUM) {
+        return false;
+    }
+
+    *width = s_yuy2_frames[frame - 1].width;
+    *height = s_yuy2_frames[frame - 1].height;
+    uint32_t interval = s_committed_interval;
+    *fps = (interval > 0) ? (10000000 / interval) : 1;
+    if (*fps == 0) {
+        *fps = 1;
+    }
+    return true;
+}
+
+uint32_t usb_desc_stream_bytes_per_frame(uint32_t fps)
+{
+    return usb_desc_stream_bytes_per_second() / (fps > 0 ? fps : 1);
+}
+
+uint32_t usb_desc_stream_bytes_per_second(void)
+{
+    return STREAM_PAYLOAD_BYTES_PER_MS * 1000;
+}
+
+const char *usb_desc_stream_mode(void)
+{
+#if CONFIG_UVC_MODE_BULK_CAM1
+    return "bulk";
+#else
+    return "isochronous";
+#endif
+}
+
+uint16_t usb_desc_stream_ep_size(void)
+{
+    return STREAM_EP_SIZE;
+}
+
+/* ======================================================================
+ * Part 4: Payload header PTS / SCR
+ *
+ * TinyUSB only writes the 2-byte payload header. The header lives at the
+ * start of the streaming endpoint buffer and its bHeaderLength decides
+ * where TinyUSB copies the payload data, so growing it to 12 bytes before
+ * each frame is queued makes room for PTS and SCR (UVC 1.5, 2.4.3.3).
+ * The buffer address is learnt from the first transfer on the video
+ * endpoint, so the very first frame after boot goes out without them.
+ *
+ * Both are in units of UVC_CLOCK_FREQUENCY, the dwClockFrequency of the
+ * VC interface header: PTS is the sensor capture time, SCR pairs the
+ * device time with the USB frame number when the frame is queued.
+ * ====================================================================== */
+
+// DWC2 OTG core (ESP32-S3 TRM, USB OTG registers): DSTS.SOFFN, bits 8..21,
+// holds the frame number of the last SOF received
+#define USB_OTG_DSTS_REG        (0x60080000 + 0x808)
+#define USB_OTG_DSTS_SOFFN(v)   (((v) >> 8) & 0x3FFF)
+
+#define PAYLOAD_HDR_FID         (1u << 0)
+#define PAYLOAD_HDR_EOF         (1u << 1)
+#define PAYLOAD_HDR_PTS         (1u << 2)
+#define PAYLOAD_HDR_SCR         (1u << 3)
+#define PAYLOAD_HDR_ERR         (1u << 6)
+#define PAYLOAD_HDR_EOH         (1u << 7)
+
+extern bool __real_usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes);
+extern bool __real_tud_video_n_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
+                                          void *buffer, size_t bufsize);
+
+static uint8_t *volatile s_payload_hdr = NULL;
+static volatile int64_t s_frame_capture_us = 0;
+
+static bool slice_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
+static void slice_fix_header(uint8_t *hdr);
+
+static inline uint32_t clock_from_us(int64_t us)
+{
+    return (uint32_t)(((uint64_t)us * UVC_CLOCK_FREQUENCY) / 1000000ULL);
+}
+
+bool __wrap_usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
+{
+    if (ep_addr == MY_EPNUM_VIDEO_IN) {
+        if (s_payload_hdr == NULL) {
+            s_payload_hdr = buffer;
+        }
+        if (buffer == s_payload_hdr) {
+            slice_fix_header(buffer);
+        }
+    }
+    return __real_usbd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+}
+
+bool __wrap_tud_video_n_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx,
+                                   void *buffer, size_t bufsize)
+{
+    // No transfer is in flight between frames, so the header is ours
+    uint8_t *hdr = s_payload_hdr;
+    if (hdr != NULL) {
+        uint32_t pts = clock_from_us(s_frame_capture_us);
+        uint32_t stc = clock_from_us(esp_timer_get_time());
+        uint16_t sof = (uint16_t)(USB_OTG_DSTS_SOFFN(REG_READ(USB_OTG_DSTS_REG)) & 0x7FF);
+
+        hdr[0] = PAYLOAD_HDR_LEN;
+        hdr[1] |= PAYLOAD_HDR_PTS | PAYLOAD_HDR_SCR | PAYLOAD_HDR_EOH;
+        hdr[1] &= ~PAYLOAD_HDR_ERR;
+        memcpy(&hdr[2], &pts, sizeof(pts));
+        memcpy(&hdr[6], &stc, sizeof(stc));
+        memcpy(&hdr[10], &sof, sizeof(sof));
+    }
+    if (slice_frame_xfer(ctl_idx, stm_idx)) {
+        return true;
+    }
+    return __real_tud_video_n_frame_xfer(ctl_idx, stm_idx, buffer, bufsize);
+}
+
+void usb_desc_set_frame_capture_time(int64_t capture_us)
+{
+    s_frame_capture_us = capture_us;
+}
+
+/* ======================================================================
+ * Part 5: Sliced MJPEG frames
+ *
+ * TinyUSB needs a frame's length when it is queued, so a frame that is
+ * still being encoded goes out as a chain of TinyUSB frame transfers, one
+ * per batch of bytes the encoder has finished. The payload headers are
+ * rewritten on the way out so that the host sees a single frame: FID stays
+ * that of the first batch and EOF (plus ERR if the encoder gave up) is only
+ * left on the last packet of the last batch. TinyUSB toggles FID and clears
+ * EOF in the endpoint buffer when a transfer completes, before it calls
+ * tud_video_frame_xfer_complete_cb, which is wrapped to start the next
+ * batch instead of reporting the frame done to usb_device_uvc.
+ *
+ * Batches are queued from a small task woken by the encoder and by batch
+ * completion, so TinyUSB is never re-entered from its own callback. Until
+ * the frame is complete only whole payloads are sent and the last byte is
+ * held back, so the final batch is never empty.
+ * ====================================================================== */
+
+#define SLICE_TASK_STACK    3072
+#define SLICE_TASK_PRIO     6
+#define SLICE_TASK_CORE     0
+#define SLICE_GRANULE       (STREAM_EP_SIZE - PAYLOAD_HDR_LEN)
+
+extern void __real_tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx);
+
+static TaskHandle_t s_slice_task = NULL;
+// Frame handed over by usb_desc_stream_sliced(), taken by the next xfer
+static volatile bool s_slice_pending = false;
+static const uint8_t *s_slice_buf = NULL;
+static usb_desc_slice_poll_t s_slice_poll = NULL;
+static usb_desc_slice_done_t s_slice_done = NULL;
+static void *s_slice_arg = NULL;
+// Frame being sent
+static volatile bool s_slice_active = false;
+static volatile bool s_slice_busy = false;      // A batch is in flight
+static volatile bool s_slice_last = false;      // The batch in flight ends the frame
+static volatile bool s_slice_failed = false;
+static volatile int s_slice_fid = -1;           // Learnt from the frame's first packet
+static size_t s_slice_sent = 0;
+static uint8_t s_slice_ctl = 0;
+static uint8_t s_slice_stm = 0;
+
+static void slice_fix_header(uint8_t *hdr)
+{
+    if (!s_slice_active) {
+        return;
+    }
+    if (s_slice_fid < 0) {
+        s_slice_fid = hdr[1] & PAYLOAD_HDR_FID;
+    }
+    hdr[1] = (hdr[1] & ~PAYLOAD_HDR_FID) | (uint8_t)s_slice_fid;
+    if (!s_slice_last) {
+        hdr[1] &= ~PAYLOAD_HDR_EOF;
+    } else if (s_slice_failed && (hdr[1] & PAYLOAD_HDR_EOF)) {
+        hdr[1] |= PAYLOAD_HDR_ERR;
+    }
+}
+
+// End the frame and report it done to usb_device_uvc
+static void slice_finish(void)
+{
+    usb_desc_slice_done_t done = s_slice_done;
+    void *arg = s_slice_arg;
+
+    s_slice_active = false;
+    s_slice_busy = false;
+    if (done != NULL) {
+        done(arg);
+    }
+    __real_tud_video_frame_xfer_complete_cb(s_slice_ctl, s_slice_stm);
+}
+
+static void slice_pump(void)
+{
+    if (!s_slice_active || s_slice_busy) {
+        return;
+    }
+
+    bool done = false;
+    bool failed = false;
+    size_t ready = s_slice_poll(s_slice_arg, &done, &failed);
+    size_t len = 0;
+    if (done || failed) {
+        len = (ready > s_slice_sent) ? ready - s_slice_sent : 0;
+    } else if (ready > s_slice_sent + 1) {
+        len = ready - s_slice_sent - 1;
+        len -= len % SLICE_GRANULE;
+    }
+    if (len == 0) {
+        if (done || failed) {
+            slice_finish();
+        }
+        return;
+    }
+
+    s_slice_last = done || failed;
+    s_slice_failed = failed;
+    s_slice_busy = true;
+    if (!__real_tud_video_n_frame_xfer(s_slice_ctl, s_slice_stm,
+                                       (void *)(s_slice_buf + s_slice_sent), len)) {
+        // Streaming stopped under us
+        slice_finish();
+        return;
+    }
+    s_slice_sent += len;
+}
+
+static void slice_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        slice_pump();
+    }
+}
+
+// usb_device_uvc queues the frame fb_get_cb returned: send it in slices
+static bool slice_frame_xfer(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
+{
+    if (!s_slice_pending) {
+        return false;
+    }
+    s_slice_pending = false;
+    s_slice_ctl = (uint8_t)ctl_idx;
+    s_slice_stm = (uint8_t)stm_idx;
+    s_slice_sent = 0;
+    s_slice_fid = -1;
+    s_slice_last = false;
+    s_slice_failed = false;
+    s_slice_busy = false;
+    s_slice_active = true;
+    xTaskNotifyGive(s_slice_task);
+    return true;
+}
+
+void __wrap_tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
+{
+    if (s_slice_active) {
+        if (s_slice_last) {
+            slice_finish();
+        } else {
+            s_slice_busy = false;
+            xTaskNotifyGive(s_slice_task);
+        }
+        return;
+    }
+    __real_tud_video_frame_xfer_complete_cb(ctl_idx, stm_idx);
+}
+
+esp_err_t usb_desc_slices_init(void)
+{
+    BaseType_t created = xTaskCreatePinnedToCore(slice_task, "uvc_slice", SLICE_TASK_STACK, NULL,
+                                                 SLICE_TASK_PRIO, &s_slice_task, SLICE_TASK_CORE);
+    return (created == pdPASS) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void usb_desc_stream_sliced(const uint8_t *buf, usb_desc_slice_poll_t poll,
+                            usb_desc_slice_done_t done, void *arg)
+{
+    s_slice_buf = buf;
+    s_slice_poll = poll;
+    s_slice_done = done;
+    s_slice_arg = arg;
+    s_slice_pending = (s_slice_task != NULL);
+}
+
+void usb_desc_slice_kick(void)
+{
+    if (s_slice_task != NULL && s_slice_active) {
+        xTaskNotifyGive(s_slice_task);
+    }
+}
+
+void usb_desc_slices_drop_pending(void)
+{
+    if (!s_slice_pending) {
+        return;
+    }
+    s_slice_pending = false;
+    if (s_slice_done != NULL) {
+        s_slice_done(s_slice_arg);
+    }
+}
+
+void usb_desc_slices_abort(void)
+{
+    s_slice_pending = false;
+    s_slice_active = false;
+    s_slice_busy = false;
+}
+
+/* ======================================================================
+ * Part 6: Enumeration time
+ *
+ * The device enumerates while the camera is still starting; the mount
+ * callback marks when the host finished configuring it.
+ * ====================================================================== */
+
+extern void __real_tud_mount_cb(void);
+
+void __wrap_tud_mount_cb(void)
+{
+    boot_status_mark(BOOT_STAGE_USB_MOUNTED);
+    __real_tud_mount_cb();
+}
@@ -0,0 +1,105 @@
+#include <stdatomic.h>
+#include "esp_heap_caps.h"
+#include "uvc_ctrl_params.h"
+#include "uvc_telemetry.h"
+
+// Running window, written by the encoder task per frame
+static atomic_uint s_win_frames = 0;
+static atomic_uint s_win_encode_us = 0;
+static atomic_uint s_win_encode_max = 0;
+static atomic_uint s_win_bytes = 0;
+
+// Last closed window, read by GET_CUR
+static atomic_uint s_fps_x10 = 0;
+static atomic_uint s_encode_us_avg = 0;
+static atomic_uint s_encode_us_max = 0;
+static atomic_uint s_frame_bytes_avg = 0;
+static atomic_uint s_dropped = 0;
+static atomic_uint s_cpu_load_x10[CPU_LOAD_CORE_COUNT];
+
+void uvc_telemetry_record_frame(uint32_t encode_us, uint32_t bytes)
+{
+    atomic_fetch_add_explicit(&s_win_frames, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_win_encode_us, encode_us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_win_bytes, bytes, memory_order_relaxed);
+    // Single writer, so a plain compare is enough
+    if (encode_us > atomic_load_explicit(&s_win_encode_max, memory_order_relaxed)) {
+        atomic_store_explicit(&s_win_encode_max, encode_us, memory_order_relaxed);
+    }
+}
+
+void uvc_telemetry_publish(const frame_pipeline_stats_t *stats)
+{
+    uint32_t frames = atomic_exchange_explicit(&s_win_frames, 0, memory_order_relaxed);
+    uint32_t encode_us = atomic_exchange_explicit(&s_win_encode_us, 0, memory_order_relaxed);
+    uint32_t bytes = atomic_exchange_explicit(&s_win_bytes, 0, memory_order_relaxed);
+    uint32_t encode_max = atomic_exchange_explicit(&s_win_encode_max, 0, memory_order_relaxed);
+
+    // A window without frames (idle, or a stalled stream) reports zeros
+    atomic_store_explicit(&s_encode_us_avg, frames > 0 ? encode_us / frames : 0, memory_order_relaxed);
+    atomic_store_explicit(&s_frame_bytes_avg, frames > 0 ? bytes / frames : 0, memory_order_relaxed);
+    atomic_store_explicit(&s_encode_us_max, encode_max, memory_order_relaxed);
+    atomic_store_explicit(&s_fps_x10, stats->usb_fps_x10, memory_order_relaxed);
+    atomic_store_explicit(&s_dropped, stats->dropped + stats->stale, memory_order_relaxed);
+    for (int core = 0; core < CPU_LOAD_CORE_COUNT; core++) {
+        atomic_store_explicit(&s_cpu_load_x10[core], stats->cpu_load_x10[core], memory_order_relaxed);
+    }
+}
+
+static int64_t telemetry_get_cur(uint8_t control_selector)
+{
+    switch (control_selector) {
+    // Per-frame figures drop to zero as soon as the stream stops, without
+    // waiting for the next window
+    case UVC_XU_TELEMETRY_FPS_X10:
+        return frame_pipeline_streaming() ? atomic_load(&s_fps_x10) : 0;
+    case UVC_XU_TELEMETRY_ENCODE_US_AVG:
+        return frame_pipeline_streaming() ? atomic_load(&s_encode_us_avg) : 0;
+    case UVC_XU_TELEMETRY_ENCODE_US_MAX:
+        return frame_pipeline_streaming() ? atomic_load(&s_encode_us_max) : 0;
+    case UVC_XU_TELEMETRY_FRAME_BYTES_AVG:
+        return frame_pipeline_streaming() ? atomic_load(&s_frame_bytes_avg) : 0;
+    case UVC_XU_TELEMETRY_DROPPED:
+        return atomic_load(&s_dropped);
+    case UVC_XU_TELEMETRY_FREE_INTERNAL:
+        return (int64_t)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    case UVC_XU_TELEMETRY_FREE_PSRAM:
+        return (int64_t)heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    case UVC_XU_TELEMETRY_CPU0_LOAD_X10:
+        return atomic_load(&s_cpu_load_x10[0]);
+    case UVC_XU_TELEMETRY_CPU1_LOAD_X10:
+        return atomic_load(&s_cpu_load_x10[1]);
+    default:
+        return 0;
+    }
+}
+
+#define TELEMETRY_ENTRY(selector, entry_name) \
+    {                                                   \
+        .entity_id = UVC_ENTITY_ID_EXTENSION_UNIT,      \
+        .control_selector = (selector),                 \
+        .name = (entry_name),                           \
+        .data_len = 4,                                  \
+        .min = 0,                                       \
+        .max = INT32_MAX,                               \
+        .res = 1,                                       \
+        .def = 0,                                       \
+        .get_cur = telemetry_get_cur,                   \
+    }
+
+const uvc_ctrl_entry_t g_uvc_telemetry_entries[] = {
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_FPS_X10, "TelemetryFpsX10"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_ENCODE_US_AVG, "TelemetryEncodeUsAvg"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_ENCODE_US_MAX, "TelemetryEncodeUsMax"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_FRAME_BYTES_AVG, "TelemetryFrameBytesAvg"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_DROPPED, "TelemetryDropped"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_FREE_INTERNAL, "TelemetryFreeInternal"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_FREE_PSRAM, "TelemetryFreePsram"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_CPU0_LOAD_X10, "TelemetryCpu0LoadX10"),
+    TELEMETRY_ENTRY(UVC_XU_TELEMETRY_CPU1_LOAD_X10, "TelemetryCpu1LoadX10"),
+};
+
+const size_t g_uvc_telemetry_entry_count = sizeof(g_uvc_telemetry_entries) / sizeof(g_uvc_telemetry_entries[0]);
+
+_Static_assert(sizeof(g_uvc_telemetry_entries) / sizeof(g_uvc_telemetry_entries[0]) == UVC_XU_TELEMETRY_CONTROL_COUNT,
+               "telemetry table out of sync with its bmControls");
@@ -0,0 +1,49 @@
+#ifndef COLOR_CONV_H
+#define COLOR_CONV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Picture adjustment with Q7 gains (128 = 1.0), applied around mid-grey:
+ *   Y' = 128 + y_offset + (Y - 128) * y_gain / 128
+ *   U' = 128 + ((U - 128) * chroma[0] + (V - 128) * chroma[1]) / 128
+ *   V' = 128 + ((U - 128) * chroma[2] + (V - 128) * chroma[3]) / 128
+ * clamped to 0..255.
+ */
+typedef struct {
+    int16_t y_gain;
+    int16_t y_offset;
+    int16_t chroma[4];
+} color_conv_adjust_t;
+
+/**
+ * RGB565 (big-endian, as delivered by esp32-camera) to packed YUYV (YUY2),
+ * BT.601 limited range. Chroma is averaged over each horizontal pixel pair.
+ * pixel_count must be even.
+ *
+ * Uses the ESP32-S3 PIE kernel for 16-byte aligned buffers when available
+ * and verified by color_conv_selftest(); otherwise the scalar reference.
+ * While a non-identity adjustment is set, a scalar kernel with the
+ * adjustment folded into per-channel tables is used instead.
+ */
+void color_conv_rgb565_to_yuyv(const uint8_t *src, uint8_t *dst, size_t pixel_count);
+
+// Fold an adjustment into the conversion tables; NULL restores the identity
+void color_conv_set_adjust(const color_conv_adjust_t *adjust);
+
+// Portable scalar reference; the SIMD kernel must match it bit for bit
+void color_conv_rgb565_to_yuyv_scalar(const uint8_t *src, uint8_t *dst, size_t pixel_count);
+
+/**
+ * Compare the SIMD kernel against the scalar reference on a synthetic
+ * pattern. On mismatch the SIMD kernel is disabled. Returns true when the
+ * outputs are identical or when no SIMD kernel is built in.
+ */
+bool color_conv_selftest(void);
+
+// True when color_conv_rgb565_to_yuyv dispatches to the SIMD kernel
+bool color_conv_simd_active(void);
+
+#endif
@@ -0,0 +1,214 @@
+#include <string.h>
+#include "color_conv.h"
+
+/*
+ * Fixed-point BT.601 limited-range coefficients with 7 fractional bits
+ * (half of the usual 8-bit set) so that every intermediate fits in a
+ * signed 16-bit lane of the SIMD kernel without saturating:
+ *
+ *   Y = ((33R + 64G + 13B + 64) >> 7) + 16
+ *   U = ((u0 + u1 + 128) >> 8) + 128,  u = -19R - 37G + 56B
+ *   V = ((v0 + v1 + 128) >> 8) + 128,  v =  56R - 47G -  9B
+ *
+ * where u0/u1 and v0/v1 belong to the two pixels of a YUYV pair.
+ */
+
+static inline void unpack_rgb565(const uint8_t *p, int32_t *r, int32_t *g, int32_t *b)
+{
+    int32_t r5 = p[0] >> 3;
+    int32_t g6 = ((p[0] & 0x07) << 3) | (p[1] >> 5);
+    int32_t b5 = p[1] & 0x1F;
+
+    *r = (r5 << 3) | (r5 >> 2);
+    *g = (g6 << 2) | (g6 >> 4);
+    *b = (b5 << 3) | (b5 >> 2);
+}
+
+static inline uint8_t luma(int32_t r, int32_t g, int32_t b)
+{
+    return (uint8_t)(((33 * r + 64 * g + 13 * b + 64) >> 7) + 16);
+}
+
+void color_conv_rgb565_to_yuyv_scalar(const uint8_t *src, uint8_t *dst, size_t pixel_count)
+{
+    for (size_t i = 0; i + 1 < pixel_count; i += 2) {
+        int32_t r0, g0, b0, r1, g1, b1;
+        unpack_rgb565(src, &r0, &g0, &b0);
+        unpack_rgb565(src + 2, &r1, &g1, &b1);
+
+        int32_t u = (-19 * r0 - 37 * g0 + 56 * b0) + (-19 * r1 - 37 * g1 + 56 * b1);
+        int32_t v = (56 * r0 - 47 * g0 - 9 * b0) + (56 * r1 - 47 * g1 - 9 * b1);
+
+        dst[0] = luma(r0, g0, b0);
+        dst[1] = (uint8_t)(((u + 128) >> 8) + 128);
+        dst[2] = luma(r1, g1, b1);
+        dst[3] = (uint8_t)(((v + 128) >> 8) + 128);
+
+        src += 4;
+        dst += 4;
+    }
+}
+
+/*
+ * Adjusted conversion: brightness/contrast and the chroma matrix are
+ * linear in R, G and B, so they fold into one table per output and input
+ * channel (16.16 fixed point, indexed by the 5/6-bit component).
+ */
+typedef struct {
+    int32_t r[32];
+    int32_t g[64];
+    int32_t b[32];
+} channel_lut_t;
+
+static channel_lut_t s_lut_y;
+static channel_lut_t s_lut_u;
+static channel_lut_t s_lut_v;
+static int32_t s_lut_y_bias;
+static bool s_adjust_active = false;
+
+static inline uint8_t clamp_u8(int32_t v)
+{
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static void fill_lut(channel_lut_t *lut, int32_t kr, int32_t kg, int32_t kb, int32_t scale)
+{
+    for (int i = 0; i < 32; i++) {
+        int32_t c = (i << 3) | (i >> 2);
+        lut->r[i] = kr * c * scale;
+        lut->b[i] = kb * c * scale;
+    }
+    for (int i = 0; i < 64; i++) {
+        int32_t c = (i << 2) | (i >> 4);
+        lut->g[i] = kg * c * scale;
+    }
+}
+
+void color_conv_set_adjust(const color_conv_adjust_t *adjust)
+{
+    if (adjust == NULL ||
+        (adjust->y_gain == 128 && adjust->y_offset == 0 && adjust->chroma[0] == 128 &&
+         adjust->chroma[1] == 0 && adjust->chroma[2] == 0 && adjust->chroma[3] == 128)) {
+        s_adjust_active = false;
+        return;
+    }
+
+    // Y' = 128 + off + g/128 * (16 - 128 + (33R + 64G + 13B) / 128);
+    // 65536 / (128 * 128) = 4
+    int32_t g = adjust->y_gain;
+    fill_lut(&s_lut_y, 33 * g, 64 * g, 13 * g, 4);
+    s_lut_y_bias = (128 + adjust->y_offset) * 65536 + g * (16 - 128) * 512 + 32768;
+
+    // U' - 128 = (m0 * u + m1 * v) / (128 * 128) per pixel, averaged over
+    // the pair; 65536 / (128 * 128) = 4
+    const int16_t *m = adjust->chroma;
+    fill_lut(&s_lut_u, -19 * m[0] + 56 * m[1], -37 * m[0] - 47 * m[1], 56 * m[0] - 9 * m[1], 4);
+    fill_lut(&s_lut_v, -19 * m[2] + 56 * m[3], -37 * m[2] - 47 * m[3], 56 * m[2] - 9 * m[3], 4);
+    s_adjust_active = true;
+}
+
+static inline int32_t lut_sum(const channel_lut_t *lut, const uint8_t *p)
+{
+    return lut->r[p[0] >> 3] + lut->g[((p[0] & 0x07) << 3) | (p[1] >> 5)] + lut->b[p[1] & 0x1F];
+}
+
+static void rgb565_to_yuyv_adjusted(const uint8_t *src, uint8_t *dst, size_t pixel_count)
+{
+    for (size_t i = 0; i + 1 < pixel_count; i += 2) {
+        int32_t u = (lut_sum(&s_lut_u, src) + lut_sum(&s_lut_u, src + 2)) >> 1;
+        int32_t v = (lut_sum(&s_lut_v, src) + lut_sum(&s_lut_v, src + 2)) >> 1;
+
+        dst[0] = clamp_u8((lut_sum(&s_lut_y, src) + s_lut_y_bias) >> 16);
+        dst[1] = clamp_u8((u + 128 * 65536 + 32768) >> 16);
+        dst[2] = clamp_u8((lut_sum(&s_lut_y, src + 2) + s_lut_y_bias) >> 16);
+        dst[3] = clamp_u8((v + 128 * 65536 + 32768) >> 16);
+
+        src += 4;
+        dst += 4;
+    }
+}
+
+#if COLOR_CONV_HAVE_PIE
+
+// Constant table for the PIE kernel; offsets are hard-coded in the .S file
+static const int16_t s_pie_consts[] __attribute__((aligned(16))) = {
+    1, 8, 4, 0x1F, 0x07,    // shift helper, <<3, <<2, masks
+    33, 64, 13, 64, 16,     // luma
+    -19, -37, 56,           // u
+    -47, -9,                // v (shares 56)
+    128, 256,               // chroma rounding/offset, byte shift
+};
+
+// Converts 8 pixels per block; src and dst must be 16-byte aligned
+extern void color_conv_rgb565_to_yuyv_pie(const uint8_t *src, uint8_t *dst,
+                                          size_t blocks, const int16_t *consts);
+
+static bool s_simd_ok = true;
+
+void color_conv_rgb565_to_yuyv(const uint8_t *src, uint8_t *dst, size_t pixel_count)
+{
+    if (s_adjust_active) {
+        rgb565_to_yuyv_adjusted(src, dst, pixel_count);
+        return;
+    }
+    if (s_simd_ok && (((uintptr_t)src | (uintptr_t)dst) & 0x0F) == 0) {
+        size_t blocks = pixel_count / 8;
+        color_conv_rgb565_to_yuyv_pie(src, dst, blocks, s_pie_consts);
+        src += blocks * 16;
+        dst += blocks * 16;
+        pixel_count -= blocks * 8;
+    }
+    color_conv_rgb565_to_yuyv_scalar(src, dst, pixel_count);
+}
+
+bool color_conv_selftest(void)
+{
+    enum { PIXELS = 64 };
+    static uint8_t src[PIXELS * 2] __attribute__((aligned(16)));
+    static uint8_t simd[PIXELS * 2] __attribute__((aligned(16)));
+    static uint8_t ref[PIXELS * 2] __attribute__((aligned(16)));
+
+    // Extremes first, then an LCG pattern covering the remaining range
+    uint32_t seed = 0x12345678;
+    for (size_t i = 0; i < sizeof(src); i++) {
+        if (i < 8) {
+            src[i] = (i & 2) ? 0xFF : 0x00;
+        } else {
+            seed = seed * 1664525u + 1013904223u;
+            src[i] = (uint8_t)(seed >> 24);
+        }
+    }
+
+    color_conv_rgb565_to_yuyv_pie(src, simd, PIXELS / 8, s_pie_consts);
+    color_conv_rgb565_to_yuyv_scalar(src, ref, PIXELS);
+    s_simd_ok = (memcmp(simd, ref, sizeof(ref)) == 0);
+    return s_simd_ok;
+}
+
+bool color_conv_simd_active(void)
+{
+    return s_simd_ok;
+}
+
+#else
+
+void color_conv_rgb565_to_yuyv(const uint8_t *src, uint8_t *dst, size_t pixel_count)
+{
+    if (s_adjust_active) {
+        rgb565_to_yuyv_adjusted(src, dst, pixel_count);
+        return;
+    }
+    color_conv_rgb565_to_yuyv_scalar(src, dst, pixel_count);
+}
+
+bool color_conv_selftest(void)
+{
+    return true;
+}
+
+bool color_conv_simd_active(void)
+{
+    return false;
+}
+
+#endif
@@ -4,7 +4,15 @@
 #include <stdint.h>
 #include "lvgl.h"
 
+typedef struct {
+    uint32_t changes;           // expression changes that moved something
+    uint32_t last_pixels;       // pixels invalidated by the latest change
+    uint64_t total_pixels;
+} stackchanface_redraw_stats_t;
+
 void stackchanface_init(lv_obj_t *parent);
+// Call with the display lock held; only the eye areas that change are redrawn
 void stackchanface_set_brightness(uint8_t brightness);
+void stackchanface_get_redraw_stats(stackchanface_redraw_stats_t *out);
 
 #endif
@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <string.h>
 #include "avatar.h"
 
 typedef struct {
@@ -11,27 +12,48 @@ typedef struct {
     lv_point_precise_t mouth_pts[2];
     uint8_t current_brightness;
     bool inited;
+    stackchanface_redraw_stats_t stats;
 } stackchanface_avatar_t;
 
 static stackchanface_avatar_t s_avatar = {0};
 
-static void set_mouth_line(int16_t x1, int16_t y1, int16_t x2, int16_t y2)
-{
-    s_avatar.mouth_pts[0].x = x1;
-    s_avatar.mouth_pts[0].y = y1;
-    s_avatar.mouth_pts[1].x = x2;
-    s_avatar.mouth_pts[1].y = y2;
-    lv_line_set_points(s_avatar.mouth_line, s_avatar.mouth_pts, 2);
-}
-
-static void show_mouth_line(bool show)
-{
-    if (show) {
-        lv_obj_clear_flag(s_avatar.mouth_line, LV_OBJ_FLAG_HIDDEN);
-    } else {
-        lv_obj_add_flag(s_avatar.mouth_line, LV_OBJ_FLAG_HIDDEN);
-    }
-}
+// Face layout inside the 320x240 container
+#define FACE_W          320
+#define FACE_H          240
+#define EYE_W           18      // Also the fully open eye height
+#define EYE_MASK_W      18      // Eyelid mask, a circle
+#define EYE_X           60      // BASIC EYE position: (-60, -20) and (60, -20)
+#define EYE_Y           (-20)
+
+/*
+ * Expression geometry for every brightness value, computed at compile
+ * time: 0 -> sad, 128 -> neutral, 255 -> happy.
+ */
+typedef struct {
+    int8_t eye_h;
+    int8_t eye_dy;
+    int8_t mask_offset;     // eyelid mask below the eye centre, 0 = hidden
+} face_geom_t;
+
+#define SMILE_START         170
+#define MASK_BASE_OFFSET    12      // below eye center
+#define MASK_MIN_OFFSET     2       // still below eye center
+
+#define GEOM_EYE_H(b)   ((b) <= 128 ? 6 + ((EYE_W - 6) * (b)) / 128 : EYE_W)
+#define GEOM_EYE_DY(b)  ((b) <= 128 ? (6 * (128 - (b))) / 128 : 0)
+#define GEOM_MASK(b) \
+    ((b) >= SMILE_START \
+     ? MASK_BASE_OFFSET - ((MASK_BASE_OFFSET - MASK_MIN_OFFSET) * ((b) - SMILE_START)) / (255 - SMILE_START) \
+     : 0)
+
+#define GEOM(b)     { GEOM_EYE_H(b), GEOM_EYE_DY(b), GEOM_MASK(b) }
+#define GEOM4(b)    GEOM(b), GEOM((b) + 1), GEOM((b) + 2), GEOM((b) + 3)
+#define GEOM16(b)   GEOM4(b), GEOM4((b) + 4), GEOM4((b) + 8), GEOM4((b) + 12)
+#define GEOM64(b)   GEOM16(b), GEOM16((b) + 16), GEOM16((b) + 32), GEOM16((b) + 48)
+
+static const face_geom_t s_geom[256] = {
+    GEOM64(0), GEOM64(64), GEOM64(128), GEOM64(192),
+};
 
 static void set_eye_height(int16_t h)
 {
@@ -41,11 +63,10 @@ static void set_eye_height(int16_t h)
     lv_obj_set_style_radius(s_avatar.eye_r, h / 2, 0);
 }
 
-static void set_eye_offset(int16_t dx_l, int16_t dx_r, int16_t dy)
+static void set_eye_offset(int16_t dy)
 {
-    // BASIC EYE position: (-60, -20) and (60, -20)
-    lv_obj_align(s_avatar.eye_l, LV_ALIGN_CENTER, -60 + dx_l, -20 + dy);
-    lv_obj_align(s_avatar.eye_r, LV_ALIGN_CENTER, 60 + dx_r, -20 + dy);
+    lv_obj_align(s_avatar.eye_l, LV_ALIGN_CENTER, -EYE_X, EYE_Y + dy);
+    lv_obj_align(s_avatar.eye_r, LV_ALIGN_CENTER, EYE_X, EYE_Y + dy);
 }
 
 static void set_eye_mask_offset(int16_t offset)
@@ -66,15 +87,22 @@ static void set_eye_mask_offset(int16_t offset)
     lv_obj_set_style_translate_y(s_avatar.eye_mask_r, offset, 0);
 }
 
-static uint8_t clamp_brightness(int64_t brightness)
+// Screen area covered by one eye and its mask (eye_x = offset from centre)
+static void eye_area(const face_geom_t *g, int16_t eye_x, lv_area_t *area)
 {
-    if (brightness < 0) {
-        return 0;
-    }
-    if (brightness > 255) {
-        return 255;
+    lv_area_t face;
+    lv_obj_get_coords(s_avatar.container, &face);
+
+    int32_t top = face.y1 + (FACE_H - g->eye_h) / 2 + EYE_Y + g->eye_dy;
+    area->x1 = face.x1 + (FACE_W - EYE_W) / 2 + eye_x;
+    area->x2 = area->x1 + EYE_W - 1;
+    area->y1 = top;
+    area->y2 = top + g->eye_h - 1;
+    if (g->mask_offset > 0) {
+        int32_t mask_top = top + (g->eye_h - EYE_MASK_W) / 2 + g->mask_offset;
+        area->y1 = LV_MIN(area->y1, mask_top);
+        area->y2 = LV_MAX(area->y2, mask_top + EYE_MASK_W - 1);
     }
-    return (uint8_t)brightness;
 }
 
 void stackchanface_init(lv_obj_t *parent)
@@ -90,28 +118,28 @@ void stackchanface_init(lv_obj_t *parent)
 
     s_avatar.container = lv_obj_create(parent);
     lv_obj_remove_style_all(s_avatar.container);
-    lv_obj_set_size(s_avatar.container, 320, 240);
+    lv_obj_set_size(s_avatar.container, FACE_W, FACE_H);
     lv_obj_center(s_avatar.container);
 
     lv_color_t bg_color = lv_obj_get_style_bg_color(parent, 0);
 
     // ============ BASIC EYE ================
     s_avatar.eye_l = lv_obj_create(s_avatar.container);
-    lv_obj_set_size(s_avatar.eye_l, 18, 18);
-    lv_obj_set_style_radius(s_avatar.eye_l, 9, 0);
+    lv_obj_set_size(s_avatar.eye_l, EYE_W, EYE_W);
+    lv_obj_set_style_radius(s_avatar.eye_l, EYE_W / 2, 0);
     lv_obj_set_style_bg_color(s_avatar.eye_l, lv_color_hex(0xffffff), 0);
     lv_obj_set_style_border_width(s_avatar.eye_l, 0, 0);
-    lv_obj_align(s_avatar.eye_l, LV_ALIGN_CENTER, -60, -20);
+    lv_obj_align(s_avatar.eye_l, LV_ALIGN_CENTER, -EYE_X, EYE_Y);
 
     s_avatar.eye_r = lv_obj_create(s_avatar.container);
-    lv_obj_set_size(s_avatar.eye_r, 18, 18);
-    lv_obj_set_style_radius(s_avatar.eye_r, 9, 0);
+    lv_obj_set_size(s_avatar.eye_r, EYE_W, EYE_W);
+    lv_obj_set_style_radius(s_avatar.eye_r, EYE_W / 2, 0);
     lv_obj_set_style_bg_color(s_avatar.eye_r, lv_color_hex(0xffffff), 0);
     lv_obj_set_style_border_width(s_avatar.eye_r, 0, 0);
-    lv_obj_align(s_avatar.eye_r, LV_ALIGN_CENTER, 60, -20);
+    lv_obj_align(s_avatar.eye_r, LV_ALIGN_CENTER, EYE_X, EYE_Y);
 
     s_avatar.eye_mask_l = lv_obj_create(s_avatar.container);
-    lv_obj_set_size(s_avatar.eye_mask_l, 18, 18);
+    lv_obj_set_size(s_avatar.eye_mask_l, EYE_MASK_W, EYE_MASK_W);
     lv_obj_set_style_radius(s_avatar.eye_mask_l, LV_RADIUS_CIRCLE, 0);
     lv_obj_set_style_bg_color(s_avatar.eye_mask_l, bg_color, 0);
     lv_obj_set_style_bg_opa(s_avatar.eye_mask_l, LV_OPA_COVER, 0);
@@ -122,7 +150,7 @@ void stackchanface_init(lv_obj_t *parent)
     lv_obj_align(s_avatar.eye_mask_l, LV_ALIGN_CENTER, 0, 0);
 
     s_avatar.eye_mask_r = lv_obj_create(s_avatar.container);
-    lv_obj_set_size(s_avatar.eye_mask_r, 18, 18);
+    lv_obj_set_size(s_avatar.eye_mask_r, EYE_MASK_W, EYE_MASK_W);
     lv_obj_set_style_radius(s_avatar.eye_mask_r, LV_RADIUS_CIRCLE, 0);
     lv_obj_set_style_bg_color(s_avatar.eye_mask_r, bg_color, 0);
     lv_obj_set_style_bg_opa(s_avatar.eye_mask_r, LV_OPA_COVER, 0);
@@ -145,8 +173,8 @@ void stackchanface_init(lv_obj_t *parent)
     lv_obj_set_style_line_color(s_avatar.mouth_line, lv_color_hex(0xffffff), 0);
     lv_obj_align(s_avatar.mouth_line, LV_ALIGN_CENTER, 0, 30);
 
-    s_avatar.current_brightness = 255;
-    stackchanface_set_brightness(128);
+    // The objects above are the neutral geometry
+    s_avatar.current_brightness = 128;
 }
 
 void stackchanface_set_brightness(uint8_t brightness)
@@ -158,36 +186,54 @@ void stackchanface_set_brightness(uint8_t brightness)
         return;
     }
 
+    const face_geom_t *from = &s_geom[s_avatar.current_brightness];
+    const face_geom_t *to = &s_geom[brightness];
     s_avatar.current_brightness = brightness;
+    if (memcmp(from, to, sizeof(*to)) == 0) {
+        return;
+    }
 
-    // Reset to BASIC positions
-    show_mouth_line(true);
-    set_mouth_line(-53, 0, 53, 0);  // BASIC MOUTH width
-    set_eye_offset(0, 0, 0);  // BASIC EYE position
-
-    // 0 -> sad, 128 -> neutral, 255 -> happy
-    uint8_t clamped = clamp_brightness(brightness);
-    const uint8_t smile_start = 170;
-    const int16_t mask_base_offset = 12;  // below eye center
-    const int16_t mask_min_offset = 2;    // still below eye center
-    int16_t eye_height = 18;
-    int16_t eye_dy = 0;
-    int16_t mask_offset = 0;
-    if (clamped <= 128) {
-        eye_height = 6 + (int16_t)((12 * clamped) / 128);
-        eye_dy = (int16_t)((6 * (128 - clamped)) / 128);
-        mask_offset = 0;
-    } else {
-        eye_height = 18;
-        eye_dy = 0;
-        if (clamped >= smile_start) {
-            int16_t range = mask_base_offset - mask_min_offset;
-            mask_offset = mask_base_offset - (int16_t)((range * (clamped - smile_start)) / (255 - smile_start));
-        } else {
-            mask_offset = 0;
-        }
+    // Write only what changed with invalidation off and settle the layout,
+    // then invalidate the union of the old and new eye areas once. Layout
+    // left pending by other objects (preview, status dot) is settled first,
+    // with invalidation on, so their redraws are not swallowed
+    bool eye_moved = (from->eye_h != to->eye_h) || (from->eye_dy != to->eye_dy);
+    lv_display_t *disp = lv_obj_get_display(s_avatar.container);
+    lv_obj_update_layout(s_avatar.container);
+    lv_display_enable_invalidation(disp, false);
+    if (from->eye_h != to->eye_h) {
+        set_eye_height(to->eye_h);
+    }
+    if (from->eye_dy != to->eye_dy) {
+        set_eye_offset(to->eye_dy);
+    }
+    if (from->mask_offset != to->mask_offset || (to->mask_offset > 0 && eye_moved)) {
+        set_eye_mask_offset(to->mask_offset);
+    }
+    lv_obj_update_layout(s_avatar.container);
+    lv_display_enable_invalidation(disp, true);
+
+    uint32_t pixels = 0;
+    for (int side = 0; side < 2; side++) {
+        int16_t eye_x = side ? EYE_X : -EYE_X;
+        lv_area_t area;
+        lv_area_t to_area;
+        eye_area(from, eye_x, &area);
+        eye_area(to, eye_x, &to_area);
+        area.x1 = LV_MIN(area.x1, to_area.x1);
+        area.y1 = LV_MIN(area.y1, to_area.y1);
+        area.x2 = LV_MAX(area.x2, to_area.x2);
+        area.y2 = LV_MAX(area.y2, to_area.y2);
+        lv_obj_invalidate_area(s_avatar.container, &area);
+        pixels += lv_area_get_size(&area);
     }
-    set_eye_height(eye_height);
-    set_eye_offset(0, 0, eye_dy);
-    set_eye_mask_offset(mask_offset);
+
+    s_avatar.stats.changes++;
+    s_avatar.stats.last_pixels = pixels;
+    s_avatar.stats.total_pixels += pixels;
+}
+
+void stackchanface_get_redraw_stats(stackchanface_redraw_stats_t *out)
+{
+    *out = s_avatar.stats;
 }
@@ -0,0 +1,171 @@
+#ifndef JPEG_ENC_H
+#define JPEG_ENC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Baseline JPEG encoder for big-endian RGB565 frames (as delivered by
+ * esp32-camera), YCbCr 4:2:0, standard Huffman tables.
+ *
+ * All state lives in jpeg_enc_t, so encoding allocates nothing. The
+ * colour conversion and quantization kernels use ESP32-S3 PIE when built
+ * for that target and verified by jpeg_enc_selftest(); everything else is
+ * plain C and also builds on a host.
+ */
+
+#define JPEG_ENC_MCU_SIZE   16      // 4:2:0 MCU is 16x16 pixels
+
+// Words in the per-encoder SIMD constant table (see jpeg_enc_pie.S)
+#define JPEG_ENC_PIE_CONSTS 24
+
+/*
+ * Picture adjustment folded into colour conversion, in level-shifted
+ * sample units (-128..127) with Q7 gains (128 = 1.0):
+ *
+ *   Y'  = clamp(((Y * y_gain) >> 7) + y_offset)
+ *   Cb' = clamp(((Cb * chroma[0]) >> 7) + ((Cr * chroma[1]) >> 7))
+ *   Cr' = clamp(((Cb * chroma[2]) >> 7) + ((Cr * chroma[3]) >> 7))
+ *
+ * Gains are limited to 0..255 (magnitude) and the offset to -128..127 so
+ * that every intermediate fits a 16-bit SIMD lane.
+ */
+typedef struct {
+    int16_t y_gain;
+    int16_t y_offset;
+    int16_t chroma[4];
+} jpeg_enc_adjust_t;
+
+typedef struct {
+    // Per-MCU workspace, 16-byte aligned for the SIMD kernels
+    int16_t y[JPEG_ENC_MCU_SIZE * JPEG_ENC_MCU_SIZE] __attribute__((aligned(16)));
+    int16_t cb_px[JPEG_ENC_MCU_SIZE * JPEG_ENC_MCU_SIZE] __attribute__((aligned(16)));
+    int16_t cr_px[JPEG_ENC_MCU_SIZE * JPEG_ENC_MCU_SIZE] __attribute__((aligned(16)));
+    int16_t cb[64] __attribute__((aligned(16)));
+    int16_t cr[64] __attribute__((aligned(16)));
+    int16_t coef[64] __attribute__((aligned(16)));
+    int16_t quant[64] __attribute__((aligned(16)));
+
+    // SIMD constants, including the current adjustment
+    int16_t pie_consts[JPEG_ENC_PIE_CONSTS] __attribute__((aligned(16)));
+    // Scalar lookup tables for the same adjustment, indexed by sample + 128
+    int16_t y_lut[256];
+    int16_t chroma_lut[4][256];
+    bool adjust_active;
+
+    // Reciprocal divisors in natural order (AAN scaling folded in)
+    int16_t recip_luma[64] __attribute__((aligned(16)));
+    int16_t recip_chroma[64] __attribute__((aligned(16)));
+    // Quantization tables as written to DQT, zigzag order
+    uint8_t qt_luma[64];
+    uint8_t qt_chroma[64];
+    uint8_t quality;
+
+    // Frame in progress (jpeg_enc_begin .. jpeg_enc_finish)
+    uint16_t width;
+    uint16_t height;
+    bool simd;
+
+    // Entropy coder state
+    int16_t dc_pred[3];
+    uint8_t next_rst;       // RSTn marker number of the next restart
+    uint32_t bit_buf;
+    int bit_cnt;
+    uint8_t *out;
+    size_t out_cap;
+    size_t out_len;
+    bool overflow;
+} jpeg_enc_t;
+
+void jpeg_enc_init(jpeg_enc_t *enc);
+
+// Quality 1..100 (libjpeg scaling); tables are rebuilt only on change
+void jpeg_enc_set_quality(jpeg_enc_t *enc, uint8_t quality);
+
+// Set the picture adjustment; NULL restores the identity (no tables used)
+void jpeg_enc_set_adjust(jpeg_enc_t *enc, const jpeg_enc_adjust_t *adjust);
+
+/**
+ * Encode one frame into a caller-supplied buffer. width must be a multiple
+ * of 16; the last MCU row repeats the bottom line when height is not.
+ *
+ * Returns false when the frame does not fit in out_cap; *out_len is then 0.
+ */
+bool jpeg_enc_encode(jpeg_enc_t *enc, const uint8_t *rgb565,
+                     uint16_t width, uint16_t height,
+                     uint8_t *out, size_t out_cap, size_t *out_len);
+
+/**
+ * Incremental form of jpeg_enc_encode() for callers that stage the frame
+ * through a small buffer, one MCU row (16 lines) at a time. The bitstream
+ * is identical.
+ *
+ * jpeg_enc_begin() writes the headers. Each jpeg_enc_encode_strip() call
+ * encodes the next MCU row from `rows` lines (16, fewer for the last row)
+ * starting at strip with a stride of width * 2; it returns false once the
+ * output has overflowed. jpeg_enc_finish() writes EOI and reports the
+ * length, or false on overflow.
+ */
+bool jpeg_enc_begin(jpeg_enc_t *enc, uint16_t width, uint16_t height,
+                    uint8_t *out, size_t out_cap);
+bool jpeg_enc_encode_strip(jpeg_enc_t *enc, const uint8_t *strip, uint16_t rows);
+bool jpeg_enc_finish(jpeg_enc_t *enc, size_t *out_len);
+
+// Bytes at the start of out that are final; up to 7 bits are still pending
+static inline size_t jpeg_enc_output_len(const jpeg_enc_t *enc)
+{
+    return enc->out_len;
+}
+
+/*
+ * Restart-interval bands, for encoding one frame on several cores.
+ *
+ * The frame is cut into horizontal bands of band_rows MCU rows and each
+ * band is one JPEG restart interval (DRI / RSTn), so its entropy-coded data
+ * does not depend on any other band. The frame context writes the headers
+ * with jpeg_enc_begin_restart() and encodes band 0 in place; other bands
+ * are encoded by further contexts (same quality and adjustment) into their
+ * own buffers between jpeg_enc_begin_band() and jpeg_enc_end_band(). The
+ * frame context then appends them in order with jpeg_enc_restart() and
+ * ends with jpeg_enc_finish(). All bands are fed with
+ * jpeg_enc_encode_strip() like a whole frame.
+ *
+ * The coefficients are those of jpeg_enc_encode(), so a decoder produces
+ * the same pixels; only the markers and padding bits differ.
+ */
+
+// MCU rows per band to split the frame into `bands`; 0 when DRI cannot
+// express it
+uint16_t jpeg_enc_band_rows(uint16_t width, uint16_t height, int bands);
+bool jpeg_enc_begin_restart(jpeg_enc_t *enc, uint16_t width, uint16_t height, uint16_t band_rows,
+                            uint8_t *out, size_t out_cap);
+bool jpeg_enc_begin_band(jpeg_enc_t *enc, uint16_t width, uint8_t *out, size_t out_cap);
+// Pad the band to a byte boundary and report its length (0 on overflow)
+bool jpeg_enc_end_band(jpeg_enc_t *enc, size_t *out_len);
+// End the current interval with the next RSTn marker and append the
+// following band's data (NULL to keep encoding it with this context). The
+// band may lie later in this context's own output buffer
+bool jpeg_enc_restart(jpeg_enc_t *enc, const uint8_t *band, size_t len);
+
+// Move the end of the output buffer, e.g. to take back space lent to a band
+static inline void jpeg_enc_set_output_cap(jpeg_enc_t *enc, size_t out_cap)
+{
+    enc->out_cap = out_cap;
+}
+
+/**
+ * Encode a synthetic frame with the SIMD kernels and with the scalar
+ * reference and compare the bitstreams. On mismatch the SIMD kernels are
+ * disabled. Returns true when identical or when no SIMD kernel is built in.
+ */
+bool jpeg_enc_selftest(void);
+
+// True when the SIMD kernels are in use
+bool jpeg_enc_simd_active(void);
+
+// Switch between SIMD and scalar kernels (for A/B timing); SIMD stays off
+// if the self-test failed
+void jpeg_enc_use_simd(bool enable);
+
+#endif
@@ -0,0 +1,833 @@
+#include <string.h>
+#include "jpeg_enc.h"
+
+/*
+ * Pipeline per 16x16 MCU:
+ *
+ *   RGB565 -> Y, per-pixel Cb/Cr (ycc_row)  -> 2x2 chroma sum (downsample)
+ *   -> AAN forward DCT (fdct) -> reciprocal quantization (quantize)
+ *   -> Huffman coding
+ *
+ * The picture adjustment (jpeg_enc_adjust_t) is applied inside ycc_row for
+ * luma and inside downsample for chroma, so it costs no extra pass. The
+ * scalar kernels use lookup tables rebuilt by jpeg_enc_set_adjust(); the
+ * SIMD kernels compute the same values arithmetically.
+ *
+ * Fixed-point JFIF (full range) coefficients, scaled so that every
+ * intermediate fits in a signed 16-bit SIMD lane:
+ *
+ *   Y  = ((38R + 75G + 15B + 64) >> 7) - 128
+ *   Cb = min((cb00 + cb01 + cb10 + cb11 + 128) >> 8, 127),  cb = -11R - 21G + 32B
+ *   Cr = min((cr00 + cr01 + cr10 + cr11 + 128) >> 8, 127),  cr =  32R - 27G -  5B
+ *
+ * The one exception is the chroma rounding of a pure blue (Cb) or pure red
+ * (Cr) 2x2 block: 4 * 8160 + 128 = 32768. The SIMD add saturates it to
+ * 32767 and the scalar path clamps the result, so both give 127.
+ *
+ * Samples are level-shifted to -128..127 as the DCT expects.
+ */
+
+static const uint8_t s_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// ITU T.81 Annex K base tables, natural order
+static const uint8_t s_base_qt_luma[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t s_base_qt_chroma[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// AAN output scale factors, 1.0 = 16384
+static const uint16_t s_aan_scales[64] = {
+    16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+    22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+    21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+    19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+    16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+    12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+     8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+     4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247,
+};
+
+static const uint8_t s_dc_luma_bits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t s_dc_chroma_bits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t s_dc_vals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t s_ac_luma_bits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t s_ac_luma_vals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t s_ac_chroma_bits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t s_ac_chroma_vals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} huff_table_t;
+
+// Shared, read-only once built: DC luma, DC chroma, AC luma, AC chroma
+static huff_table_t s_huff[4];
+static bool s_huff_built;
+
+enum { HUFF_DC_LUMA = 0, HUFF_DC_CHROMA, HUFF_AC_LUMA, HUFF_AC_CHROMA };
+
+static void build_huff(huff_table_t *t, const uint8_t bits[16], const uint8_t *vals)
+{
+    uint16_t code = 0;
+    size_t k = 0;
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < bits[len - 1]; i++) {
+            t->code[vals[k]] = code++;
+            t->size[vals[k]] = (uint8_t)len;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+// ---- scalar kernels (the SIMD kernels must match these bit for bit) ----
+
+static void ycc_row_scalar(const uint8_t *src, int16_t *y, int16_t *cb_px, int16_t *cr_px,
+                           const int16_t *y_lut)
+{
+    for (int x = 0; x < JPEG_ENC_MCU_SIZE; x++) {
+        int32_t r5 = src[0] >> 3;
+        int32_t g6 = ((src[0] & 0x07) << 3) | (src[1] >> 5);
+        int32_t b5 = src[1] & 0x1F;
+        int32_t r = (r5 << 3) | (r5 >> 2);
+        int32_t g = (g6 << 2) | (g6 >> 4);
+        int32_t b = (b5 << 3) | (b5 >> 2);
+
+        int32_t luma = ((38 * r + 75 * g + 15 * b + 64) >> 7) - 128;
+        y[x] = y_lut ? y_lut[luma + 128] : (int16_t)luma;
+        cb_px[x] = (int16_t)(-11 * r - 21 * g + 32 * b);
+        cr_px[x] = (int16_t)(32 * r - 27 * g - 5 * b);
+        src += 2;
+    }
+}
+
+static inline int16_t sat16(int32_t v)
+{
+    return (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+}
+
+static inline int16_t clamp_sample(int32_t v)
+{
+    return (int16_t)(v > 127 ? 127 : (v < -128 ? -128 : v));
+}
+
+static inline int16_t chroma_sum(const int16_t *px, int j, int i)
+{
+    const int16_t *r0 = px + (2 * j) * JPEG_ENC_MCU_SIZE;
+    const int16_t *r1 = r0 + JPEG_ENC_MCU_SIZE;
+    int32_t sum = r0[2 * i] + r0[2 * i + 1] + r1[2 * i] + r1[2 * i + 1];
+    // 128 for a pure blue/red block, where the SIMD rounding add saturates
+    return clamp_sample((sum + 128) >> 8);
+}
+
+static void downsample_scalar(const int16_t *cb_px, const int16_t *cr_px,
+                              int16_t *cb, int16_t *cr, const int16_t (*lut)[256])
+{
+    for (int j = 0; j < 8; j++) {
+        for (int i = 0; i < 8; i++) {
+            int16_t b = chroma_sum(cb_px, j, i);
+            int16_t r = chroma_sum(cr_px, j, i);
+            if (lut) {
+                // b and r are clamped to -128..127, so the index stays below 256
+                cb[j * 8 + i] = clamp_sample(lut[0][b + 128] + lut[1][r + 128]);
+                cr[j * 8 + i] = clamp_sample(lut[2][b + 128] + lut[3][r + 128]);
+            } else {
+                cb[j * 8 + i] = b;
+                cr[j * 8 + i] = r;
+            }
+        }
+    }
+}
+
+// q = round(coef / divisor), recip = 2^15 / divisor
+static void quantize_scalar(const int16_t *coef, const int16_t *recip, int16_t *out)
+{
+    for (int i = 0; i < 64; i++) {
+        int16_t t = (int16_t)(((int32_t)coef[i] * recip[i]) >> 14);
+        out[i] = (int16_t)(sat16((int32_t)t + 1) >> 1);
+    }
+}
+
+// ---- SIMD dispatch ----
+
+// Template for jpeg_enc_t.pie_consts; offsets are hard-coded in the .S file
+enum { PIE_Y_GAIN = 16, PIE_Y_OFFSET = 17, PIE_CHROMA = 20 };
+
+static const int16_t s_pie_consts[JPEG_ENC_PIE_CONSTS] = {
+    1, 8, 4, 0x1F, 0x07,    // shift helper, <<3, <<2, masks
+    38, 75, 15, 64, -128,   // luma
+    -11, -21, 32,           // cb
+    -27, -5,                // cr (shares 32)
+    128,                    // chroma rounding
+    128, 0,                 // luma gain, offset (identity)
+    -128, 127,              // sample clamp
+    128, 0, 0, 128,         // chroma matrix (identity)
+};
+
+#if JPEG_ENC_HAVE_PIE
+
+extern void jpeg_enc_ycc_row_pie(const uint8_t *src, int16_t *y, int16_t *cb_px,
+                                 int16_t *cr_px, const int16_t *consts);
+extern void jpeg_enc_downsample_pie(const int16_t *cb_px, const int16_t *cr_px,
+                                    int16_t *cb, int16_t *cr, const int16_t *consts);
+extern void jpeg_enc_quantize_pie(const int16_t *coef, const int16_t *recip, int16_t *out,
+                                  const int16_t *consts);
+
+static bool s_simd_ok = true;
+static bool s_simd_enabled = true;
+
+#define SIMD_ON()   (s_simd_ok && s_simd_enabled)
+
+#else
+
+#define SIMD_ON()   false
+
+#endif
+
+static inline void ycc_row(const jpeg_enc_t *enc, const uint8_t *src, int16_t *y,
+                           int16_t *cb_px, int16_t *cr_px, bool simd)
+{
+#if JPEG_ENC_HAVE_PIE
+    if (simd) {
+        jpeg_enc_ycc_row_pie(src, y, cb_px, cr_px, enc->pie_consts);
+        return;
+    }
+#endif
+    (void)simd;
+    ycc_row_scalar(src, y, cb_px, cr_px, enc->adjust_active ? enc->y_lut : NULL);
+}
+
+static inline void downsample(jpeg_enc_t *enc, bool simd)
+{
+#if JPEG_ENC_HAVE_PIE
+    if (simd) {
+        jpeg_enc_downsample_pie(enc->cb_px, enc->cr_px, enc->cb, enc->cr, enc->pie_consts);
+        return;
+    }
+#endif
+    (void)simd;
+    downsample_scalar(enc->cb_px, enc->cr_px, enc->cb, enc->cr,
+                      enc->adjust_active ? (const int16_t (*)[256])enc->chroma_lut : NULL);
+}
+
+static inline void quantize(const jpeg_enc_t *enc, const int16_t *coef, const int16_t *recip,
+                            int16_t *out, bool simd)
+{
+#if JPEG_ENC_HAVE_PIE
+    if (simd) {
+        jpeg_enc_quantize_pie(coef, recip, out, enc->pie_consts);
+        return;
+    }
+#endif
+    (void)enc;
+    (void)simd;
+    quantize_scalar(coef, recip, out);
+}
+
+// ---- forward DCT ----
+
+/*
+ * Arai-Agui-Nakajima DCT with 8 fractional bits (as libjpeg's jfdctfst).
+ * The output is scaled per coefficient by s_aan_scales * 8; the quantizer
+ * divisors absorb that factor.
+ */
+#define FIX_0_382683433  98
+#define FIX_0_541196100  139
+#define FIX_0_707106781  181
+#define FIX_1_306562965  334
+#define AAN_MUL(v, c)    ((int32_t)((v) * (c)) >> 8)
+
+static void fdct_1d(int32_t *d, int step)
+{
+    int32_t tmp0 = d[0 * step] + d[7 * step];
+    int32_t tmp7 = d[0 * step] - d[7 * step];
+    int32_t tmp1 = d[1 * step] + d[6 * step];
+    int32_t tmp6 = d[1 * step] - d[6 * step];
+    int32_t tmp2 = d[2 * step] + d[5 * step];
+    int32_t tmp5 = d[2 * step] - d[5 * step];
+    int32_t tmp3 = d[3 * step] + d[4 * step];
+    int32_t tmp4 = d[3 * step] - d[4 * step];
+
+    // Even part
+    int32_t tmp10 = tmp0 + tmp3;
+    int32_t tmp13 = tmp0 - tmp3;
+    int32_t tmp11 = tmp1 + tmp2;
+    int32_t tmp12 = tmp1 - tmp2;
+    d[0 * step] = tmp10 + tmp11;
+    d[4 * step] = tmp10 - tmp11;
+    int32_t z1 = AAN_MUL(tmp12 + tmp13, FIX_0_707106781);
+    d[2 * step] = tmp13 + z1;
+    d[6 * step] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    int32_t z5 = AAN_MUL(tmp10 - tmp12, FIX_0_382683433);
+    int32_t z2 = AAN_MUL(tmp10, FIX_0_541196100) + z5;
+    int32_t z4 = AAN_MUL(tmp12, FIX_1_306562965) + z5;
+    int32_t z3 = AAN_MUL(tmp11, FIX_0_707106781);
+    int32_t z11 = tmp7 + z3;
+    int32_t z13 = tmp7 - z3;
+    d[5 * step] = z13 + z2;
+    d[3 * step] = z13 - z2;
+    d[1 * step] = z11 + z4;
+    d[7 * step] = z11 - z4;
+}
+
+// 8x8 block at src (row pitch in samples) -> coef, natural order
+static void fdct(const int16_t *src, int pitch, int16_t *coef)
+{
+    int32_t d[64];
+    for (int r = 0; r < 8; r++) {
+        for (int c = 0; c < 8; c++) {
+            d[r * 8 + c] = src[r * pitch + c];
+        }
+        fdct_1d(&d[r * 8], 1);
+    }
+    for (int c = 0; c < 8; c++) {
+        fdct_1d(&d[c], 8);
+    }
+    for (int i = 0; i < 64; i++) {
+        coef[i] = (int16_t)d[i];
+    }
+}
+
+// ---- bitstream ----
+
+static inline void emit_byte(jpeg_enc_t *enc, uint8_t b)
+{
+    if (enc->out_len < enc->out_cap) {
+        enc->out[enc->out_len++] = b;
+    } else {
+        enc->overflow = true;
+    }
+}
+
+static void emit_bytes(jpeg_enc_t *enc, const uint8_t *data, size_t len)
+{
+    if (enc->out_len + len > enc->out_cap) {
+        enc->overflow = true;
+        return;
+    }
+    memcpy(enc->out + enc->out_len, data, len);
+    enc->out_len += len;
+}
+
+static inline void emit_u16(jpeg_enc_t *enc, uint16_t v)
+{
+    emit_byte(enc, (uint8_t)(v >> 8));
+    emit_byte(enc, (uint8_t)v);
+}
+
+static inline void put_bits(jpeg_enc_t *enc, uint32_t code, int size)
+{
+    enc->bit_buf = (enc->bit_buf << size) | (code & ((1u << size) - 1));
+    enc->bit_cnt += size;
+    while (enc->bit_cnt >= 8) {
+        uint8_t b = (uint8_t)(enc->bit_buf >> (enc->bit_cnt - 8));
+        emit_byte(enc, b);
+        if (b == 0xFF) {
+            emit_byte(enc, 0x00);   // byte stuffing
+        }
+        enc->bit_cnt -= 8;
+    }
+}
+
+static void flush_bits(jpeg_enc_t *enc)
+{
+    if (enc->bit_cnt > 0) {
+        put_bits(enc, 0x7F, 8 - enc->bit_cnt);  // pad with ones
+    }
+    enc->bit_buf = 0;
+    enc->bit_cnt = 0;
+}
+
+static inline int bit_length(int32_t v)
+{
+    uint32_t a = (uint32_t)(v < 0 ? -v : v);
+    int n = 0;
+    while (a) {
+        n++;
+        a >>= 1;
+    }
+    return n;
+}
+
+static void encode_block(jpeg_enc_t *enc, const int16_t *q, int comp,
+                         const huff_table_t *dc, const huff_table_t *ac)
+{
+    int32_t diff = q[0] - enc->dc_pred[comp];
+    enc->dc_pred[comp] = q[0];
+
+    int n = bit_length(diff);
+    put_bits(enc, dc->code[n], dc->size[n]);
+    if (n) {
+        put_bits(enc, (uint32_t)(diff < 0 ? diff - 1 : diff), n);
+    }
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int32_t v = q[s_zigzag[k]];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            put_bits(enc, ac->code[0xF0], ac->size[0xF0]);
+            run -= 16;
+        }
+        n = bit_length(v);
+        int sym = (run << 4) | n;
+        put_bits(enc, ac->code[sym], ac->size[sym]);
+        put_bits(enc, (uint32_t)(v < 0 ? v - 1 : v), n);
+        run = 0;
+    }
+    if (run) {
+        put_bits(enc, ac->code[0x00], ac->size[0x00]);
+    }
+}
+
+// ---- headers ----
+
+static void write_dht(jpeg_enc_t *enc, uint8_t class_id, const uint8_t bits[16],
+                      const uint8_t *vals, size_t count)
+{
+    emit_byte(enc, class_id);
+    emit_bytes(enc, bits, 16);
+    emit_bytes(enc, vals, count);
+}
+
+static void write_headers(jpeg_enc_t *enc, uint16_t width, uint16_t height, uint16_t restart_mcus)
+{
+    static const uint8_t soi_app0[] = {
+        0xFF, 0xD8,
+        0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00,
+        0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+    };
+    emit_bytes(enc, soi_app0, sizeof(soi_app0));
+
+    emit_u16(enc, 0xFFDB);
+    emit_u16(enc, 2 + 2 * 65);
+    emit_byte(enc, 0x00);
+    emit_bytes(enc, enc->qt_luma, 64);
+    emit_byte(enc, 0x01);
+    emit_bytes(enc, enc->qt_chroma, 64);
+
+    // SOF0: Y 2x2 on table 0, Cb/Cr 1x1 on table 1
+    emit_u16(enc, 0xFFC0);
+    emit_u16(enc, 17);
+    emit_byte(enc, 8);
+    emit_u16(enc, height);
+    emit_u16(enc, width);
+    static const uint8_t comps[] = { 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    emit_bytes(enc, comps, sizeof(comps));
+
+    emit_u16(enc, 0xFFC4);
+    emit_u16(enc, 2 + 4 * 17 + 2 * sizeof(s_dc_vals) + 2 * sizeof(s_ac_luma_vals));
+    write_dht(enc, 0x00, s_dc_luma_bits, s_dc_vals, sizeof(s_dc_vals));
+    write_dht(enc, 0x10, s_ac_luma_bits, s_ac_luma_vals, sizeof(s_ac_luma_vals));
+    write_dht(enc, 0x01, s_dc_chroma_bits, s_dc_vals, sizeof(s_dc_vals));
+    write_dht(enc, 0x11, s_ac_chroma_bits, s_ac_chroma_vals, sizeof(s_ac_chroma_vals));
+
+    if (restart_mcus != 0) {
+        emit_u16(enc, 0xFFDD);
+        emit_u16(enc, 4);
+        emit_u16(enc, restart_mcus);
+    }
+
+    static const uint8_t sos[] = {
+        0xFF, 0xDA, 0x00, 0x0C, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0,
+    };
+    emit_bytes(enc, sos, sizeof(sos));
+}
+
+// ---- public API ----
+
+void jpeg_enc_init(jpeg_enc_t *enc)
+{
+    memset(enc, 0, sizeof(*enc));
+    memcpy(enc->pie_consts, s_pie_consts, sizeof(enc->pie_consts));
+    if (!s_huff_built) {
+        build_huff(&s_huff[HUFF_DC_LUMA], s_dc_luma_bits, s_dc_vals);
+        build_huff(&s_huff[HUFF_DC_CHROMA], s_dc_chroma_bits, s_dc_vals);
+        build_huff(&s_huff[HUFF_AC_LUMA], s_ac_luma_bits, s_ac_luma_vals);
+        build_huff(&s_huff[HUFF_AC_CHROMA], s_ac_chroma_bits, s_ac_chroma_vals);
+        s_huff_built = true;
+    }
+}
+
+static void build_quant(const uint8_t *base, int scale, uint8_t *qt_zigzag, int16_t *recip)
+{
+    for (int i = 0; i < 64; i++) {
+        int32_t q = (base[i] * scale + 50) / 100;
+        q = q < 1 ? 1 : (q > 255 ? 255 : q);
+
+        // Divisor of the AAN-scaled coefficient; >= 2 keeps recip in 16 bits
+        int32_t div = (q * s_aan_scales[i] + (1 << 10)) >> 11;
+        div = div < 2 ? 2 : div;
+        recip[i] = (int16_t)((32768 + div / 2) / div);
+    }
+    for (int k = 0; k < 64; k++) {
+        int32_t q = (base[s_zigzag[k]] * scale + 50) / 100;
+        qt_zigzag[k] = (uint8_t)(q < 1 ? 1 : (q > 255 ? 255 : q));
+    }
+}
+
+void jpeg_enc_set_quality(jpeg_enc_t *enc, uint8_t quality)
+{
+    quality = quality < 1 ? 1 : (quality > 100 ? 100 : quality);
+    if (quality == enc->quality) {
+        return;
+    }
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    build_quant(s_base_qt_luma, scale, enc->qt_luma, enc->recip_luma);
+    build_quant(s_base_qt_chroma, scale, enc->qt_chroma, enc->recip_chroma);
+    enc->quality = quality;
+}
+
+void jpeg_enc_set_adjust(jpeg_enc_t *enc, const jpeg_enc_adjust_t *adjust)
+{
+    static const jpeg_enc_adjust_t identity = {
+        .y_gain = 128,
+        .y_offset = 0,
+        .chroma = { 128, 0, 0, 128 },
+    };
+    if (adjust == NULL) {
+        adjust = &identity;
+    }
+
+    enc->pie_consts[PIE_Y_GAIN] = adjust->y_gain;
+    enc->pie_consts[PIE_Y_OFFSET] = adjust->y_offset;
+    for (int k = 0; k < 4; k++) {
+        enc->pie_consts[PIE_CHROMA + k] = adjust->chroma[k];
+    }
+
+    for (int v = -128; v < 128; v++) {
+        enc->y_lut[v + 128] = clamp_sample(((v * adjust->y_gain) >> 7) + adjust->y_offset);
+        for (int k = 0; k < 4; k++) {
+            enc->chroma_lut[k][v + 128] = (int16_t)((v * adjust->chroma[k]) >> 7);
+        }
+    }
+    enc->adjust_active = (memcmp(adjust, &identity, sizeof(identity)) != 0);
+}
+
+static void encode_mcu(jpeg_enc_t *enc, const uint8_t *const rows[JPEG_ENC_MCU_SIZE], bool simd)
+{
+    for (int r = 0; r < JPEG_ENC_MCU_SIZE; r++) {
+        ycc_row(enc, rows[r], &enc->y[r * JPEG_ENC_MCU_SIZE],
+                &enc->cb_px[r * JPEG_ENC_MCU_SIZE], &enc->cr_px[r * JPEG_ENC_MCU_SIZE], simd);
+    }
+    downsample(enc, simd);
+
+    for (int b = 0; b < 4; b++) {
+        const int16_t *blk = &enc->y[(b >> 1) * 8 * JPEG_ENC_MCU_SIZE + (b & 1) * 8];
+        fdct(blk, JPEG_ENC_MCU_SIZE, enc->coef);
+        quantize(enc, enc->coef, enc->recip_luma, enc->quant, simd);
+        encode_block(enc, enc->quant, 0, &s_huff[HUFF_DC_LUMA], &s_huff[HUFF_AC_LUMA]);
+    }
+    fdct(enc->cb, 8, enc->coef);
+    quantize(enc, enc->coef, enc->recip_chroma, enc->quant, simd);
+    encode_block(enc, enc->quant, 1, &s_huff[HUFF_DC_CHROMA], &s_huff[HUFF_AC_CHROMA]);
+    fdct(enc->cr, 8, enc->coef);
+    quantize(enc, enc->coef, enc->recip_chroma, enc->quant, simd);
+    encode_block(enc, enc->quant, 2, &s_huff[HUFF_DC_CHROMA], &s_huff[HUFF_AC_CHROMA]);
+}
+
+// Point the entropy coder at out with fresh DC predictors, no headers
+static bool begin_scan(jpeg_enc_t *enc, uint16_t width, uint16_t height,
+                       uint8_t *out, size_t out_cap, bool simd)
+{
+    if (width == 0 || height == 0 || (width % JPEG_ENC_MCU_SIZE) != 0) {
+        return false;
+    }
+    if (enc->quality == 0) {
+        jpeg_enc_set_quality(enc, 80);
+    }
+
+    enc->width = width;
+    enc->height = height;
+    enc->simd = simd;
+    enc->out = out;
+    enc->out_cap = out_cap;
+    enc->out_len = 0;
+    enc->overflow = false;
+    enc->bit_buf = 0;
+    enc->bit_cnt = 0;
+    enc->next_rst = 0;
+    memset(enc->dc_pred, 0, sizeof(enc->dc_pred));
+    return true;
+}
+
+static bool begin_frame(jpeg_enc_t *enc, uint16_t width, uint16_t height, uint16_t restart_mcus,
+                        uint8_t *out, size_t out_cap, bool simd)
+{
+    if (!begin_scan(enc, width, height, out, out_cap, simd)) {
+        return false;
+    }
+    write_headers(enc, width, height, restart_mcus);
+    return true;
+}
+
+static bool encode_strip(jpeg_enc_t *enc, const uint8_t *strip, uint16_t rows)
+{
+    if (enc->overflow || rows == 0) {
+        return false;
+    }
+
+    // PIE loads need every MCU row start 16-byte aligned; the stride is a
+    // multiple of 32 since the width is a multiple of 16
+    size_t stride = (size_t)enc->width * 2;
+    bool simd = enc->simd && ((uintptr_t)strip & 0x0F) == 0;
+
+    const uint8_t *lines[JPEG_ENC_MCU_SIZE];
+    for (int r = 0; r < JPEG_ENC_MCU_SIZE; r++) {
+        lines[r] = strip + ((r < rows) ? r : rows - 1) * stride;
+    }
+    for (uint16_t mx = 0; mx < enc->width; mx += JPEG_ENC_MCU_SIZE) {
+        const uint8_t *mcu[JPEG_ENC_MCU_SIZE];
+        for (int r = 0; r < JPEG_ENC_MCU_SIZE; r++) {
+            mcu[r] = lines[r] + mx * 2;
+        }
+        encode_mcu(enc, mcu, simd);
+    }
+    return !enc->overflow;
+}
+
+static bool finish_frame(jpeg_enc_t *enc, size_t *out_len)
+{
+    flush_bits(enc);
+    emit_u16(enc, 0xFFD9);
+
+    *out_len = 0;
+    if (enc->overflow) {
+        return false;
+    }
+    *out_len = enc->out_len;
+    return true;
+}
+
+static bool encode_frame(jpeg_enc_t *enc, const uint8_t *rgb565, uint16_t width, uint16_t height,
+                         uint8_t *out, size_t out_cap, size_t *out_len, bool simd)
+{
+    *out_len = 0;
+    if (!begin_frame(enc, width, height, 0, out, out_cap, simd)) {
+        return false;
+    }
+
+    size_t stride = (size_t)width * 2;
+    for (uint16_t my = 0; my < height; my += JPEG_ENC_MCU_SIZE) {
+        uint16_t rows = (height - my < JPEG_ENC_MCU_SIZE) ? height - my : JPEG_ENC_MCU_SIZE;
+        if (!encode_strip(enc, rgb565 + my * stride, rows)) {
+            break;
+        }
+    }
+    return finish_frame(enc, out_len);
+}
+
+bool jpeg_enc_encode(jpeg_enc_t *enc, const uint8_t *rgb565,
+                     uint16_t width, uint16_t height,
+                     uint8_t *out, size_t out_cap, size_t *out_len)
+{
+    return encode_frame(enc, rgb565, width, height, out, out_cap, out_len, SIMD_ON());
+}
+
+bool jpeg_enc_begin(jpeg_enc_t *enc, uint16_t width, uint16_t height,
+                    uint8_t *out, size_t out_cap)
+{
+    return begin_frame(enc, width, height, 0, out, out_cap, SIMD_ON());
+}
+
+bool jpeg_enc_encode_strip(jpeg_enc_t *enc, const uint8_t *strip, uint16_t rows)
+{
+    return encode_strip(enc, strip, rows);
+}
+
+bool jpeg_enc_finish(jpeg_enc_t *enc, size_t *out_len)
+{
+    return finish_frame(enc, out_len);
+}
+
+uint16_t jpeg_enc_band_rows(uint16_t width, uint16_t height, int bands)
+{
+    uint16_t mcu_rows = (height + JPEG_ENC_MCU_SIZE - 1) / JPEG_ENC_MCU_SIZE;
+    uint16_t mcu_cols = width / JPEG_ENC_MCU_SIZE;
+    uint16_t rows = (uint16_t)((mcu_rows + bands - 1) / bands);
+    // DRI counts MCUs in 16 bits
+    if (mcu_cols == 0 || (uint32_t)rows * mcu_cols > 0xFFFF) {
+        return 0;
+    }
+    return rows;
+}
+
+bool jpeg_enc_begin_restart(jpeg_enc_t *enc, uint16_t width, uint16_t height, uint16_t band_rows,
+                            uint8_t *out, size_t out_cap)
+{
+    uint32_t restart_mcus = (uint32_t)band_rows * (width / JPEG_ENC_MCU_SIZE);
+    if (restart_mcus == 0 || restart_mcus > 0xFFFF) {
+        return false;
+    }
+    return begin_frame(enc, width, height, (uint16_t)restart_mcus, out, out_cap, SIMD_ON());
+}
+
+bool jpeg_enc_begin_band(jpeg_enc_t *enc, uint16_t width, uint8_t *out, size_t out_cap)
+{
+    return begin_scan(enc, width, JPEG_ENC_MCU_SIZE, out, out_cap, SIMD_ON());
+}
+
+bool jpeg_enc_end_band(jpeg_enc_t *enc, size_t *out_len)
+{
+    flush_bits(enc);
+    *out_len = enc->overflow ? 0 : enc->out_len;
+    return !enc->overflow;
+}
+
+bool jpeg_enc_restart(jpeg_enc_t *enc, const uint8_t *band, size_t len)
+{
+    flush_bits(enc);
+    emit_u16(enc, (uint16_t)(0xFFD0 + enc->next_rst));
+    enc->next_rst = (enc->next_rst + 1) & 7;
+    memset(enc->dc_pred, 0, sizeof(enc->dc_pred));
+    if (band == NULL || enc->overflow) {
+        return !enc->overflow;
+    }
+    if (enc->out_len + len > enc->out_cap) {
+        enc->overflow = true;
+        return false;
+    }
+    // The band may sit further along in the same buffer
+    memmove(enc->out + enc->out_len, band, len);
+    enc->out_len += len;
+    return true;
+}
+
+#if JPEG_ENC_HAVE_PIE
+
+bool jpeg_enc_selftest(void)
+{
+    enum { W = 32, H = 32, OUT = 4096 };
+    static uint8_t src[W * H * 2] __attribute__((aligned(16)));
+    static uint8_t simd[OUT];
+    static uint8_t ref[OUT];
+    static jpeg_enc_t enc;
+
+    // Extremes first, then an LCG pattern; a smooth ramp keeps some
+    // blocks sparse so both long zero runs and dense blocks are covered
+    uint32_t seed = 0x12345678;
+    for (size_t i = 0; i < sizeof(src); i++) {
+        if (i < 64) {
+            src[i] = (i & 2) ? 0xFF : 0x00;
+        } else if (i < sizeof(src) / 2) {
+            seed = seed * 1664525u + 1013904223u;
+            src[i] = (uint8_t)(seed >> 24);
+        } else {
+            src[i] = (uint8_t)(i >> 3);
+        }
+    }
+    // Pure red and pure blue 8x8 patches, whose chroma sums need the clamp
+    for (int y = 8; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            uint8_t *p = &src[(y * W + x) * 2];
+            p[0] = (x < 8) ? 0xF8 : 0x00;
+            p[1] = (x < 8) ? 0x00 : 0x1F;
+        }
+    }
+
+    size_t simd_len = 0;
+    size_t ref_len = 0;
+    // Run once with the identity and once with a strong adjustment that
+    // drives the clamps (gain ~1.6, hue rotated, saturation ~1.9)
+    static const jpeg_enc_adjust_t adjust = {
+        .y_gain = 200,
+        .y_offset = 20,
+        .chroma = { 170, -170, 170, 170 },
+    };
+    bool ok = true;
+    jpeg_enc_init(&enc);
+    jpeg_enc_set_quality(&enc, 90);
+    for (int pass = 0; pass < 2 && ok; pass++) {
+        jpeg_enc_set_adjust(&enc, pass ? &adjust : NULL);
+        ok = encode_frame(&enc, src, W, H, simd, sizeof(simd), &simd_len, true);
+        ok = ok && encode_frame(&enc, src, W, H, ref, sizeof(ref), &ref_len, false);
+        ok = ok && simd_len == ref_len && memcmp(simd, ref, ref_len) == 0;
+    }
+    s_simd_ok = ok;
+    return s_simd_ok;
+}
+
+bool jpeg_enc_simd_active(void)
+{
+    return SIMD_ON();
+}
+
+void jpeg_enc_use_simd(bool enable)
+{
+    s_simd_enabled = enable;
+}
+
+#else
+
+bool jpeg_enc_selftest(void)
+{
+    return true;
+}
+
+bool jpeg_enc_simd_active(void)
+{
+    return false;
+}
+
+void jpeg_enc_use_simd(bool enable)
+{
+    (void)enable;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Boot-time memory plan. Each region is one block reserved from the heap
+ * with fixed capabilities; pipeline components carve their long-lived
+ * buffers out of the region that suits them instead of asking the heap
+ * (and CONFIG_SPIRAM_MALLOC_ALWAYSINTERNAL) where they end up.
+ *
+ * Allocation is a bump pointer and nothing is freed, except for boot-time
+ * scratch taken between mem_arena_scratch_begin()/end(). When a region is
+ * exhausted the arena logs the budget table and aborts, so a configuration
+ * that does not fit fails at boot rather than degrading while streaming.
+ */
+
+typedef enum {
+    MEM_ARENA_SRAM_DMA = 0,     // Internal, DMA-capable: encoder working sets, tables
+    MEM_ARENA_PSRAM,            // Bulk frame buffers
+    MEM_ARENA_REGION_COUNT,
+} mem_arena_region_t;
+
+// Named allocations recorded for the budget table
+#define MEM_ARENA_MAX_OWNERS  16
+
+// Reserve every region; aborts when the heap cannot provide one
+void mem_arena_init(const size_t capacity[MEM_ARENA_REGION_COUNT]);
+
+// Never returns NULL: aborts with the budget table when the region is full
+void *mem_arena_alloc(mem_arena_region_t region, size_t size, size_t align, const char *owner);
+
+// Temporary boot-time allocations; end() gives back everything since begin()
+void mem_arena_scratch_begin(mem_arena_region_t region);
+void mem_arena_scratch_end(mem_arena_region_t region);
+
+// Log capacity, use and high-water mark per region, every named
+// allocation, and the remaining system heap per memory type
+void mem_arena_report(void);
+
+#endif
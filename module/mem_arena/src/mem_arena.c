@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "mem_arena.h"
+
+static const char *TAG = "mem_arena";
+
+typedef struct {
+    const char *name;
+    uint32_t caps;
+    uint8_t *base;
+    size_t capacity;
+    size_t used;
+    size_t high_water;
+    size_t scratch_mark;        // SIZE_MAX outside a scratch section
+} arena_region_t;
+
+typedef struct {
+    const char *owner;
+    mem_arena_region_t region;
+    size_t size;
+} arena_owner_t;
+
+static arena_region_t s_regions[MEM_ARENA_REGION_COUNT] = {
+    [MEM_ARENA_SRAM_DMA] = { "sram-dma", MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT },
+    [MEM_ARENA_PSRAM] = { "psram", MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT },
+};
+static arena_owner_t s_owners[MEM_ARENA_MAX_OWNERS];
+static size_t s_owner_count = 0;
+
+void mem_arena_init(const size_t capacity[MEM_ARENA_REGION_COUNT])
+{
+    for (int i = 0; i < MEM_ARENA_REGION_COUNT; i++) {
+        arena_region_t *r = &s_regions[i];
+        r->capacity = capacity[i];
+        r->scratch_mark = SIZE_MAX;
+        r->base = heap_caps_aligned_alloc(16, r->capacity, r->caps);
+        if (r->base == NULL && r->capacity > 0) {
+            ESP_LOGE(TAG, "cannot reserve %u B of %s (largest free block %u B)",
+                     (unsigned)r->capacity, r->name,
+                     (unsigned)heap_caps_get_largest_free_block(r->caps));
+            abort();
+        }
+    }
+}
+
+void *mem_arena_alloc(mem_arena_region_t region, size_t size, size_t align, const char *owner)
+{
+    arena_region_t *r = &s_regions[region];
+    size_t offset = (r->used + (align - 1)) & ~(align - 1);
+    if (r->base == NULL || offset + size > r->capacity) {
+        ESP_LOGE(TAG, "%s: %u B does not fit in %s (%u of %u B used)", owner,
+                 (unsigned)size, r->name, (unsigned)r->used, (unsigned)r->capacity);
+        mem_arena_report();
+        abort();
+    }
+
+    r->used = offset + size;
+    if (r->used > r->high_water) {
+        r->high_water = r->used;
+    }
+    // Scratch allocations only show up in the high-water mark
+    if (r->scratch_mark == SIZE_MAX && s_owner_count < MEM_ARENA_MAX_OWNERS) {
+        s_owners[s_owner_count++] = (arena_owner_t){ owner, region, size };
+    }
+    return r->base + offset;
+}
+
+void mem_arena_scratch_begin(mem_arena_region_t region)
+{
+    s_regions[region].scratch_mark = s_regions[region].used;
+}
+
+void mem_arena_scratch_end(mem_arena_region_t region)
+{
+    arena_region_t *r = &s_regions[region];
+    if (r->scratch_mark != SIZE_MAX) {
+        r->used = r->scratch_mark;
+        r->scratch_mark = SIZE_MAX;
+    }
+}
+
+void mem_arena_report(void)
+{
+    ESP_LOGI(TAG, "%-10s %9s %9s %9s %9s", "region", "capacity", "used", "peak", "free");
+    for (int i = 0; i < MEM_ARENA_REGION_COUNT; i++) {
+        const arena_region_t *r = &s_regions[i];
+        ESP_LOGI(TAG, "%-10s %9u %9u %9u %9u", r->name, (unsigned)r->capacity,
+                 (unsigned)r->used, (unsigned)r->high_water, (unsigned)(r->capacity - r->used));
+        for (size_t k = 0; k < s_owner_count; k++) {
+            if (s_owners[k].region == (mem_arena_region_t)i) {
+                ESP_LOGI(TAG, "  %-18s %9u", s_owners[k].owner, (unsigned)s_owners[k].size);
+            }
+        }
+    }
+    // What is left to everything outside the plan (drivers, LVGL, tasks)
+    ESP_LOGI(TAG, "heap internal free %u (min %u) | psram free %u (min %u)",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+}
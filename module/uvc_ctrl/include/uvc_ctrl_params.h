@@ -7,14 +7,86 @@
 #define UVC_ENTITY_ID_CAMERA_TERMINAL   0x01
 #define UVC_ENTITY_ID_PROCESSING_UNIT   0x02
 #define UVC_ENTITY_ID_OUTPUT_TERMINAL   0x03
+#define UVC_ENTITY_ID_EXTENSION_UNIT    0x04
 
+// Camera Terminal control selectors (UVC 1.5, A.9.4)
+#define UVC_CT_AE_MODE_CONTROL                  0x02
+#define UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL   0x04
+
+// Processing Unit control selectors (UVC 1.5, A.9.5)
+#define UVC_PU_BACKLIGHT_COMPENSATION_CONTROL   0x01
+#define UVC_PU_BRIGHTNESS_CONTROL               0x02
+#define UVC_PU_CONTRAST_CONTROL                 0x03
+#define UVC_PU_GAIN_CONTROL                     0x04
+#define UVC_PU_POWER_LINE_FREQUENCY_CONTROL     0x05
+#define UVC_PU_HUE_CONTROL                      0x06
+#define UVC_PU_SATURATION_CONTROL               0x07
+#define UVC_PU_SHARPNESS_CONTROL                0x08
+#define UVC_PU_GAMMA_CONTROL                    0x09
+#define UVC_PU_WHITE_BALANCE_TEMP_CONTROL       0x0a
+#define UVC_PU_WHITE_BALANCE_TEMP_AUTO_CONTROL  0x0b
+#define UVC_PU_HUE_AUTO_CONTROL                 0x10
+
+// CT_AE_MODE bitmap values
+#define UVC_AE_MODE_MANUAL  0x01
+#define UVC_AE_MODE_AUTO    0x02
+
+/*
+ * Every control the device exposes. The registry dispatch table, the
+ * live values in g_uvc_ctrl_state and the bmControls bitmaps of the
+ * Camera Terminal / Processing Unit descriptors are all generated from
+ * this list, so adding a line here is all a new control needs.
+ *
+ * X(entity, selector, name, len, min, max, res, def, field)
+ *
+ * For CT_AE_MODE, res is the bitmap of supported modes; as a bitmap
+ * control it answers no GET_MIN/GET_MAX, and min/max are unused.
+ * ExposureTimeAbsolute is in 100 us units, up to the sensor's longest
+ * exposure (80 ms, see camera_ctrl.c).
+ */
 #define UVC_CTRL_PARAM_LIST(X) \
-    X(UVC_ENTITY_ID_PROCESSING_UNIT, 0x02, "Brightness", 2, 0, 0, 255, 1, 128, brightness) \
-    X(UVC_ENTITY_ID_PROCESSING_UNIT, 0x03, "Contrast", 2, 0, 0, 255, 1, 0, contrast) \
-    X(UVC_ENTITY_ID_PROCESSING_UNIT, 0x06, "Hue", 2, 0, 0, 255, 1, 0, hue) \
-    X(UVC_ENTITY_ID_PROCESSING_UNIT, 0x07, "Saturation", 2, 0, 0, 255, 1, 0, saturation) \
-    X(UVC_ENTITY_ID_PROCESSING_UNIT, 0x0b, "WhiteBalanceTempAuto", 1, 0, 0, 1, 1, 0, white_balance_temp_auto) \
-    X(UVC_ENTITY_ID_PROCESSING_UNIT, 0x10, "HueAuto", 1, 0, 0, 1, 1, 0, hue_auto)
+    X(UVC_ENTITY_ID_CAMERA_TERMINAL, UVC_CT_AE_MODE_CONTROL, "AutoExposureMode", 1, UVC_AE_MODE_MANUAL, UVC_AE_MODE_AUTO, UVC_AE_MODE_MANUAL | UVC_AE_MODE_AUTO, UVC_AE_MODE_AUTO, ae_mode) \
+    X(UVC_ENTITY_ID_CAMERA_TERMINAL, UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL, "ExposureTimeAbsolute", 4, 1, 800, 1, 300, exposure_time) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_BACKLIGHT_COMPENSATION_CONTROL, "BacklightCompensation", 2, 0, 2, 1, 0, backlight_compensation) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_BRIGHTNESS_CONTROL, "Brightness", 2, 0, 255, 1, 128, brightness) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_CONTRAST_CONTROL, "Contrast", 2, 0, 255, 1, 128, contrast) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_GAIN_CONTROL, "Gain", 2, 0, 30, 1, 0, gain) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_POWER_LINE_FREQUENCY_CONTROL, "PowerLineFrequency", 1, 0, 2, 1, 1, power_line_frequency) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_HUE_CONTROL, "Hue", 2, 0, 255, 1, 128, hue) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_SATURATION_CONTROL, "Saturation", 2, 0, 255, 1, 128, saturation) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_SHARPNESS_CONTROL, "Sharpness", 2, 0, 255, 1, 128, sharpness) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_GAMMA_CONTROL, "Gamma", 2, 100, 220, 120, 100, gamma) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_WHITE_BALANCE_TEMP_CONTROL, "WhiteBalanceTemperature", 2, 2800, 6500, 100, 5000, white_balance_temp) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_WHITE_BALANCE_TEMP_AUTO_CONTROL, "WhiteBalanceTempAuto", 1, 0, 1, 1, 1, white_balance_temp_auto) \
+    X(UVC_ENTITY_ID_PROCESSING_UNIT, UVC_PU_HUE_AUTO_CONTROL, "HueAuto", 1, 0, 1, 1, 0, hue_auto)
+
+// bmControls bit of each selector (UVC 1.5, Tables 3-6 and 3-8)
+#define UVC_CT_BM_BIT(sel) \
+    ((sel) == UVC_CT_AE_MODE_CONTROL ? 1 : \
+     (sel) == UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL ? 3 : 31)
+
+#define UVC_PU_BM_BIT(sel) \
+    ((sel) == UVC_PU_BRIGHTNESS_CONTROL ? 0 : \
+     (sel) == UVC_PU_CONTRAST_CONTROL ? 1 : \
+     (sel) == UVC_PU_HUE_CONTROL ? 2 : \
+     (sel) == UVC_PU_SATURATION_CONTROL ? 3 : \
+     (sel) == UVC_PU_SHARPNESS_CONTROL ? 4 : \
+     (sel) == UVC_PU_GAMMA_CONTROL ? 5 : \
+     (sel) == UVC_PU_WHITE_BALANCE_TEMP_CONTROL ? 6 : \
+     (sel) == UVC_PU_BACKLIGHT_COMPENSATION_CONTROL ? 8 : \
+     (sel) == UVC_PU_GAIN_CONTROL ? 9 : \
+     (sel) == UVC_PU_POWER_LINE_FREQUENCY_CONTROL ? 10 : \
+     (sel) == UVC_PU_HUE_AUTO_CONTROL ? 11 : \
+     (sel) == UVC_PU_WHITE_BALANCE_TEMP_AUTO_CONTROL ? 12 : 31)
+
+#define UVC_CTRL_CT_BM(ent, sel, entry_name, len, min_val, max_val, res_val, def_val, field) \
+    | (((ent) == UVC_ENTITY_ID_CAMERA_TERMINAL) ? (1UL << UVC_CT_BM_BIT(sel)) : 0UL)
+#define UVC_CTRL_PU_BM(ent, sel, entry_name, len, min_val, max_val, res_val, def_val, field) \
+    | (((ent) == UVC_ENTITY_ID_PROCESSING_UNIT) ? (1UL << UVC_PU_BM_BIT(sel)) : 0UL)
+
+// 24-bit bmControls for the descriptors; bit 31 flags an unmapped selector
+#define UVC_CTRL_CT_BM_CONTROLS  (0UL UVC_CTRL_PARAM_LIST(UVC_CTRL_CT_BM))
+#define UVC_CTRL_PU_BM_CONTROLS  (0UL UVC_CTRL_PARAM_LIST(UVC_CTRL_PU_BM))
 
 extern const uvc_ctrl_entry_t g_uvc_ctrl_entries[];
 extern const size_t g_uvc_ctrl_entry_count;
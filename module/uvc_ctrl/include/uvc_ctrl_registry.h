@@ -1,25 +1,38 @@
 #ifndef UVC_CTRL_REGISTRY_H
 #define UVC_CTRL_REGISTRY_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 typedef void (*uvc_ctrl_set_cb_t)(const char *name, const uint8_t *data, size_t len);
+typedef int64_t (*uvc_ctrl_get_cb_t)(uint8_t control_selector);
+
+// Lookup table bounds: entity IDs and control selectors the registry indexes
+#define UVC_CTRL_REGISTRY_MAX_ENTITY    0x07
+#define UVC_CTRL_REGISTRY_MAX_SELECTOR  0x1f
 
 typedef struct {
     uint8_t entity_id;
     uint8_t control_selector;
     const char *name;
     uint16_t data_len;
-    int32_t cur;
     int32_t min;
     int32_t max;
     int32_t res;
     int32_t def;
-    volatile int64_t *value_ptr;
-    uvc_ctrl_set_cb_t on_set;
+    bool bitmap;                    // res is the set of valid one-bit values; no MIN/MAX
+    const int64_t *value_ptr;       // live value, reported by GET_CUR
+    uvc_ctrl_get_cb_t get_cur;      // computes GET_CUR instead of value_ptr
+    uvc_ctrl_set_cb_t on_set;       // NULL for read-only controls
 } uvc_ctrl_entry_t;
 
+/**
+ * Add a control table to the (entity, selector) lookup used by
+ * uvc_ctrl_registry_handle(), so each request is one table read however
+ * many controls there are. Call once per table; entries outside the
+ * lookup bounds are ignored.
+ */
 void uvc_ctrl_registry_register(const uvc_ctrl_entry_t *entries, size_t count);
 
 int uvc_ctrl_registry_handle(uint8_t entity_id,
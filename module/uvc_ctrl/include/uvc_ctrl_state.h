@@ -2,18 +2,41 @@
 #define UVC_CTRL_STATE_H
 
 #include <stdint.h>
+#include "uvc_ctrl_params.h"
+
+// Value of every control in UVC_CTRL_PARAM_LIST
+#define UVC_CTRL_STATE_FIELD(ent, sel, entry_name, len, min_val, max_val, res_val, def_val, field) \
+    int64_t field;
 
 typedef struct {
-    volatile int64_t brightness;
-    volatile int64_t contrast;
-    volatile int64_t hue;
-    volatile int64_t saturation;
-    volatile int64_t white_balance_temp_auto;
-    volatile int64_t hue_auto;
+    UVC_CTRL_PARAM_LIST(UVC_CTRL_STATE_FIELD)
 } uvc_ctrl_state_t;
 
-extern volatile uvc_ctrl_state_t g_uvc_ctrl_state;
+#undef UVC_CTRL_STATE_FIELD
+
+/*
+ * Live values, written only by the SET_CUR handlers in the USB task. That
+ * task may read them directly; every other task must go through
+ * uvc_ctrl_state_snapshot(), since 64-bit fields can tear on this 32-bit
+ * core and a change may span several fields.
+ */
+extern uvc_ctrl_state_t g_uvc_ctrl_state;
+
+/**
+ * Copy a consistent view of all controls (seqlock read side; never blocks
+ * the writer). Returns the sequence number of the copy, which only changes
+ * when a control does, so it doubles as a cheap change detector together
+ * with uvc_ctrl_state_sequence().
+ */
+uint32_t uvc_ctrl_state_snapshot(uvc_ctrl_state_t *out);
+
+// Current sequence number; differs from the last snapshot's after any change
+uint32_t uvc_ctrl_state_sequence(void);
+
+// Value of a registry entry's control within a snapshot
+int64_t uvc_ctrl_state_value(const uvc_ctrl_state_t *snap, const uvc_ctrl_entry_t *entry);
 
+// Called after a value is published, from the USB task; keep it short
 typedef void (*uvc_ctrl_value_cb_t)(const char *name, int64_t value);
 void uvc_ctrl_state_set_callback(uvc_ctrl_value_cb_t cb);
 
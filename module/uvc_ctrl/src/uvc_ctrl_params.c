@@ -1,22 +1,68 @@
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
 #include "uvc_ctrl_params.h"
 #include "uvc_ctrl_state.h"
 
 static uvc_ctrl_value_cb_t s_value_cb = NULL;
 
-volatile uvc_ctrl_state_t g_uvc_ctrl_state = {
-    .brightness = 128,
-    .contrast = 0,
-    .hue = 0,
-    .saturation = 0,
-    .white_balance_temp_auto = 0,
-    .hue_auto = 0,
+// Seqlock: odd while a write is in progress
+static atomic_uint s_seq = 0;
+// Keeps the single writer from being preempted mid-write by a reader
+static portMUX_TYPE s_write_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#define UVC_CTRL_STATE_INIT(ent_id, selector, entry_name, len, min_val, max_val, res_val, def_val, field) \
+    .field = (def_val),
+
+uvc_ctrl_state_t g_uvc_ctrl_state = {
+    UVC_CTRL_PARAM_LIST(UVC_CTRL_STATE_INIT)
 };
 
+#undef UVC_CTRL_STATE_INIT
+
 void uvc_ctrl_state_set_callback(uvc_ctrl_value_cb_t cb)
 {
     s_value_cb = cb;
 }
 
+uint32_t uvc_ctrl_state_sequence(void)
+{
+    return atomic_load_explicit(&s_seq, memory_order_acquire);
+}
+
+uint32_t uvc_ctrl_state_snapshot(uvc_ctrl_state_t *out)
+{
+    uint32_t seq;
+    for (;;) {
+        seq = atomic_load_explicit(&s_seq, memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(out, &g_uvc_ctrl_state, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s_seq, memory_order_relaxed) == seq) {
+            return seq;
+        }
+    }
+}
+
+int64_t uvc_ctrl_state_value(const uvc_ctrl_state_t *snap, const uvc_ctrl_entry_t *entry)
+{
+    size_t offset = (size_t)((const uint8_t *)entry->value_ptr - (const uint8_t *)&g_uvc_ctrl_state);
+    return *(const int64_t *)((const uint8_t *)snap + offset);
+}
+
+static void publish_value(int64_t *field, int64_t value)
+{
+    taskENTER_CRITICAL(&s_write_lock);
+    uint32_t seq = atomic_load_explicit(&s_seq, memory_order_relaxed);
+    atomic_store_explicit(&s_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    *field = value;
+    atomic_store_explicit(&s_seq, seq + 2, memory_order_release);
+    taskEXIT_CRITICAL(&s_write_lock);
+}
+
 static int64_t read_value_le(const uint8_t *data, const size_t len)
 {
     int64_t value = 0;
@@ -30,30 +76,31 @@ static int64_t read_value_le(const uint8_t *data, const size_t len)
     static void uvc_ctrl_on_set_##field(const char *name, const uint8_t *data, size_t len) \
     {                                                                                \
         int64_t value = read_value_le(data, len);                                    \
-        g_uvc_ctrl_state.field = value;                                              \
+        publish_value(&g_uvc_ctrl_state.field, value);                               \
         if (s_value_cb) {                                                            \
             s_value_cb(name, value);                                                 \
         }                                                                            \
     }
 
-#define UVC_CTRL_DECLARE_HANDLER(ent_id, selector, entry_name, len, cur_val, min_val, max_val, res_val, def_val, field) \
+#define UVC_CTRL_DECLARE_HANDLER(ent_id, selector, entry_name, len, min_val, max_val, res_val, def_val, field) \
     UVC_CTRL_ON_SET(field)
 
 UVC_CTRL_PARAM_LIST(UVC_CTRL_DECLARE_HANDLER)
 
 #undef UVC_CTRL_DECLARE_HANDLER
 
-#define UVC_CTRL_ENTRY(ent_id, selector, entry_name, len, cur_val, min_val, max_val, res_val, def_val, field) \
+#define UVC_CTRL_ENTRY(ent_id, selector, entry_name, len, min_val, max_val, res_val, def_val, field) \
     {                                                                             \
         .entity_id = (ent_id),                                                    \
         .control_selector = (selector),                                           \
         .name = (entry_name),                                                     \
         .data_len = (len),                                                        \
-        .cur = (cur_val),                                                         \
         .min = (min_val),                                                         \
         .max = (max_val),                                                         \
         .res = (res_val),                                                         \
         .def = (def_val),                                                         \
+        .bitmap = ((ent_id) == UVC_ENTITY_ID_CAMERA_TERMINAL &&                   \
+                   (selector) == UVC_CT_AE_MODE_CONTROL),                         \
         .value_ptr = &g_uvc_ctrl_state.field,                                     \
         .on_set = uvc_ctrl_on_set_##field,                                         \
     },
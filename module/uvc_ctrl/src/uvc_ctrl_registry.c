@@ -2,25 +2,35 @@
 #include "tusb.h"
 #include "class/video/video.h"
 
-static const uvc_ctrl_entry_t *s_entries = NULL;
-static size_t s_entry_count = 0;
+// Direct-mapped (entity, selector) -> entry; hosts probe every control on open
+static const uvc_ctrl_entry_t *s_lookup[UVC_CTRL_REGISTRY_MAX_ENTITY + 1][UVC_CTRL_REGISTRY_MAX_SELECTOR + 1];
 
 void uvc_ctrl_registry_register(const uvc_ctrl_entry_t *entries, size_t count)
 {
-    s_entries = entries;
-    s_entry_count = count;
+    for (size_t i = 0; i < count; i++) {
+        const uvc_ctrl_entry_t *entry = &entries[i];
+        if (entry->entity_id <= UVC_CTRL_REGISTRY_MAX_ENTITY &&
+            entry->control_selector <= UVC_CTRL_REGISTRY_MAX_SELECTOR) {
+            s_lookup[entry->entity_id][entry->control_selector] = entry;
+        }
+    }
 }
 
-
 static const uvc_ctrl_entry_t *find_entry(uint8_t entity_id, uint8_t control_selector)
 {
-    for (size_t i = 0; i < s_entry_count; i++) {
-        const uvc_ctrl_entry_t *entry = &s_entries[i];
-        if (entry->entity_id == entity_id && entry->control_selector == control_selector) {
-            return entry;
-        }
+    if (entity_id > UVC_CTRL_REGISTRY_MAX_ENTITY || control_selector > UVC_CTRL_REGISTRY_MAX_SELECTOR) {
+        return NULL;
+    }
+    return s_lookup[entity_id][control_selector];
+}
+
+static int64_t read_value_le(const uint8_t *buf, uint16_t len)
+{
+    int64_t value = 0;
+    for (uint16_t i = 0; i < len && i < 8; i++) {
+        value |= ((int64_t)buf[i]) << (8 * i);
     }
-    return NULL;
+    return value;
 }
 
 static void write_value_le(uint8_t *buf, uint16_t len, int32_t value)
@@ -45,8 +55,8 @@ int uvc_ctrl_registry_handle(uint8_t entity_id,
     switch (request) {
     case VIDEO_REQUEST_GET_INFO:
         if (len >= 1) {
-            // Support GET/SET
-            buf[0] = 0x03;
+            // Supports GET, and SET unless read-only
+            buf[0] = (entry->on_set != NULL) ? 0x03 : 0x01;
         }
         return VIDEO_ERROR_NONE;
     case VIDEO_REQUEST_GET_LEN:
@@ -55,14 +65,19 @@ int uvc_ctrl_registry_handle(uint8_t entity_id,
             buf[1] = (uint8_t)((entry->data_len >> 8) & 0xFF);
         }
         return VIDEO_ERROR_NONE;
-    case VIDEO_REQUEST_GET_CUR:
-        write_value_le(buf, len, entry->cur);
+    case VIDEO_REQUEST_GET_CUR: {
+        int64_t value = (entry->get_cur != NULL) ? entry->get_cur(entry->control_selector)
+                                                 : *entry->value_ptr;
+        write_value_le(buf, len, (int32_t)value);
         return VIDEO_ERROR_NONE;
+    }
     case VIDEO_REQUEST_GET_MIN:
-        write_value_le(buf, len, entry->min);
-        return VIDEO_ERROR_NONE;
     case VIDEO_REQUEST_GET_MAX:
-        write_value_le(buf, len, entry->max);
+        // Not defined for bitmap controls (UVC 1.5, 4.2.2.1.2)
+        if (entry->bitmap) {
+            return VIDEO_ERROR_INVALID_REQUEST;
+        }
+        write_value_le(buf, len, (request == VIDEO_REQUEST_GET_MIN) ? entry->min : entry->max);
         return VIDEO_ERROR_NONE;
     case VIDEO_REQUEST_GET_RES:
         write_value_le(buf, len, entry->res);
@@ -71,10 +86,19 @@ int uvc_ctrl_registry_handle(uint8_t entity_id,
         write_value_le(buf, len, entry->def);
         return VIDEO_ERROR_NONE;
     case VIDEO_REQUEST_SET_CUR:
+        if (entry->on_set == NULL) {
+            return VIDEO_ERROR_INVALID_REQUEST;
+        }
         if (stage == CONTROL_STAGE_DATA) {
-            if (entry->on_set) {
-                entry->on_set(entry->name, buf, len);
+            uint16_t data_len = (len < entry->data_len) ? len : entry->data_len;
+            int64_t value = read_value_le(buf, data_len);
+            bool valid = entry->bitmap
+                         ? (value != 0 && (value & (value - 1)) == 0 && (value & ~(int64_t)entry->res) == 0)
+                         : (value >= entry->min && value <= entry->max);
+            if (!valid) {
+                return VIDEO_ERROR_OUT_OF_RANGE;
             }
+            entry->on_set(entry->name, buf, len);
         }
         return VIDEO_ERROR_NONE;
     default:
@@ -0,0 +1,321 @@
+/*
+ * Host benchmark for the frame encoders used on the device.
+ *
+ * Runs the same jpeg_enc and color_conv sources that the firmware builds
+ * (scalar kernels) over recorded big-endian RGB565 frames and reports, per
+ * resolution and JPEG quality, the time per pixel, the compressed size and
+ * the PSNR of the decoded result against the source.
+ *
+ * Corpus files are raw frames named with their size, e.g.
+ * frame_320x240_000.rgb565 (see dump_frames.py). Without a corpus a few
+ * synthetic frames are generated so the benchmark still runs.
+ *
+ * usage: encoder_bench [-q 30,50,80,90] [-n iterations] [--csv] [corpus_dir]
+ */
+
+#include <dirent.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <jpeglib.h>
+#include "color_conv.h"
+#include "jpeg_enc.h"
+
+#define MAX_FRAMES     64
+#define MAX_QUALITIES  16
+#define MAX_SIZES      8
+
+typedef struct {
+    char name[256];
+    uint16_t width;
+    uint16_t height;
+    uint8_t *pixels;
+} frame_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    int frames;
+    double yuy2_ns_px;
+    double jpeg_ns_px[MAX_QUALITIES];
+    double jpeg_bytes[MAX_QUALITIES];
+    double jpeg_psnr[MAX_QUALITIES];
+} size_result_t;
+
+static frame_t s_frames[MAX_FRAMES];
+static int s_frame_count = 0;
+static jpeg_enc_t s_enc;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int cmp_frame(const void *a, const void *b)
+{
+    return strcmp(((const frame_t *)a)->name, ((const frame_t *)b)->name);
+}
+
+static void load_corpus(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        fprintf(stderr, "cannot open corpus %s\n", dir);
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL && s_frame_count < MAX_FRAMES) {
+        unsigned w = 0;
+        unsigned h = 0;
+        const char *p = strchr(ent->d_name, '_');
+        if (p == NULL || sscanf(p + 1, "%ux%u", &w, &h) != 2 || w == 0 || h == 0) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        size_t len = (size_t)w * h * 2;
+        uint8_t *buf = aligned_alloc(16, (len + 15) & ~(size_t)15);
+        if (buf != NULL && fread(buf, 1, len, f) == len) {
+            frame_t *fr = &s_frames[s_frame_count++];
+            snprintf(fr->name, sizeof(fr->name), "%s", ent->d_name);
+            fr->width = (uint16_t)w;
+            fr->height = (uint16_t)h;
+            fr->pixels = buf;
+        } else {
+            fprintf(stderr, "skipping %s: short file\n", ent->d_name);
+            free(buf);
+        }
+        fclose(f);
+    }
+    closedir(d);
+    qsort(s_frames, s_frame_count, sizeof(s_frames[0]), cmp_frame);
+}
+
+// Gradients, hard edges and sensor-like noise; a stand-in for real frames
+static void synth_frame(uint16_t w, uint16_t h, uint32_t seed)
+{
+    frame_t *fr = &s_frames[s_frame_count++];
+    snprintf(fr->name, sizeof(fr->name), "synthetic_%ux%u_%u", w, h, seed);
+    fr->width = w;
+    fr->height = h;
+    fr->pixels = aligned_alloc(16, (size_t)w * h * 2);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            int noise = (int)(seed >> 29) - 4;
+            int r = (x * 255) / w + noise;
+            int g = (y * 255) / h + noise;
+            int b = (((x / 32) + (y / 32)) & 1) ? 220 : 40;
+            r = r < 0 ? 0 : (r > 255 ? 255 : r);
+            g = g < 0 ? 0 : (g > 255 ? 255 : g);
+            uint16_t v = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            fr->pixels[(y * w + x) * 2] = (uint8_t)(v >> 8);
+            fr->pixels[(y * w + x) * 2 + 1] = (uint8_t)v;
+        }
+    }
+}
+
+static void rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t r5 = src[0] >> 3;
+        uint8_t g6 = (uint8_t)(((src[0] & 0x07) << 3) | (src[1] >> 5));
+        uint8_t b5 = src[1] & 0x1F;
+        dst[0] = (uint8_t)((r5 << 3) | (r5 >> 2));
+        dst[1] = (uint8_t)((g6 << 2) | (g6 >> 4));
+        dst[2] = (uint8_t)((b5 << 3) | (b5 >> 2));
+        src += 2;
+        dst += 3;
+    }
+}
+
+// Decode with libjpeg and compare against the source; < 0 on decode error
+static double psnr_of(const uint8_t *jpg, size_t len, const uint8_t *ref, uint16_t w, uint16_t h)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpg, (unsigned long)len);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1.0;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    if (cinfo.output_width != w || cinfo.output_height != h) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1.0;
+    }
+
+    uint8_t *row = malloc((size_t)w * 3);
+    double sse = 0.0;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        const uint8_t *r = ref + (size_t)cinfo.output_scanline * w * 3;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+        for (size_t i = 0; i < (size_t)w * 3; i++) {
+            double d = (double)row[i] - (double)r[i];
+            sse += d * d;
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+
+    double mse = sse / ((double)w * h * 3);
+    return (mse > 0.0) ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static size_result_t *result_for(size_result_t *res, int *count, uint16_t w, uint16_t h)
+{
+    for (int i = 0; i < *count; i++) {
+        if (res[i].width == w && res[i].height == h) {
+            return &res[i];
+        }
+    }
+    if (*count == MAX_SIZES) {
+        return NULL;
+    }
+    size_result_t *r = &res[(*count)++];
+    memset(r, 0, sizeof(*r));
+    r->width = w;
+    r->height = h;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int qualities[MAX_QUALITIES] = { 30, 50, 70, 80, 90 };
+    int quality_count = 5;
+    int iterations = 5;
+    bool csv = false;
+    const char *corpus = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            quality_count = 0;
+            for (char *tok = strtok(argv[++i], ","); tok && quality_count < MAX_QUALITIES;
+                 tok = strtok(NULL, ",")) {
+                qualities[quality_count++] = atoi(tok);
+            }
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            iterations = iterations < 1 ? 1 : iterations;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [-q 30,50,80,90] [-n iterations] [--csv] [corpus_dir]\n", argv[0]);
+            return 2;
+        } else {
+            corpus = argv[i];
+        }
+    }
+
+    if (corpus != NULL) {
+        load_corpus(corpus);
+    }
+    if (s_frame_count == 0) {
+        fprintf(stderr, "no corpus frames, using synthetic 320x240 and 640x480 frames\n");
+        synth_frame(320, 240, 1);
+        synth_frame(320, 240, 2);
+        synth_frame(640, 480, 3);
+    }
+
+    jpeg_enc_init(&s_enc);
+    size_result_t results[MAX_SIZES];
+    int result_count = 0;
+    int failures = 0;
+
+    for (int f = 0; f < s_frame_count; f++) {
+        const frame_t *fr = &s_frames[f];
+        size_t pixels = (size_t)fr->width * fr->height;
+        size_t out_cap = pixels * 2;
+        uint8_t *out = aligned_alloc(16, (out_cap + 15) & ~(size_t)15);
+        uint8_t *ref = malloc(pixels * 3);
+        rgb565_to_rgb888(fr->pixels, ref, pixels);
+
+        size_result_t *res = result_for(results, &result_count, fr->width, fr->height);
+        if (res == NULL) {
+            free(out);
+            free(ref);
+            continue;
+        }
+        res->frames++;
+
+        double best = 1e30;
+        for (int it = 0; it < iterations; it++) {
+            double t0 = now_ns();
+            color_conv_rgb565_to_yuyv(fr->pixels, out, pixels);
+            double t = now_ns() - t0;
+            best = t < best ? t : best;
+        }
+        res->yuy2_ns_px += best / pixels;
+
+        for (int q = 0; q < quality_count; q++) {
+            size_t len = 0;
+            jpeg_enc_set_quality(&s_enc, (uint8_t)qualities[q]);
+            best = 1e30;
+            for (int it = 0; it < iterations; it++) {
+                double t0 = now_ns();
+                bool ok = jpeg_enc_encode(&s_enc, fr->pixels, fr->width, fr->height,
+                                          out, out_cap, &len);
+                double t = now_ns() - t0;
+                if (!ok) {
+                    fprintf(stderr, "%s q%d: encode failed\n", fr->name, qualities[q]);
+                    failures++;
+                    break;
+                }
+                best = t < best ? t : best;
+            }
+            double psnr = psnr_of(out, len, ref, fr->width, fr->height);
+            if (psnr < 0.0) {
+                fprintf(stderr, "%s q%d: output does not decode\n", fr->name, qualities[q]);
+                failures++;
+            }
+            res->jpeg_ns_px[q] += best / pixels;
+            res->jpeg_bytes[q] += (double)len;
+            res->jpeg_psnr[q] += psnr;
+        }
+        free(out);
+        free(ref);
+    }
+
+    if (csv) {
+        printf("size,codec,quality,ns_per_pixel,bytes_per_frame,psnr_db\n");
+    } else {
+        printf("%d frame(s), best of %d run(s), scalar kernels\n", s_frame_count, iterations);
+        printf("%-9s %-5s %4s %10s %12s %9s\n", "size", "codec", "q", "ns/pixel", "bytes/frame", "PSNR dB");
+    }
+    for (int i = 0; i < result_count; i++) {
+        const size_result_t *r = &results[i];
+        double n = r->frames;
+        char size[16];
+        snprintf(size, sizeof(size), "%ux%u", r->width, r->height);
+        if (csv) {
+            printf("%s,yuy2,,%.3f,%u,\n", size, r->yuy2_ns_px / n, (unsigned)(r->width * r->height * 2));
+        } else {
+            printf("%-9s %-5s %4s %10.3f %12u %9s\n", size, "yuy2", "-", r->yuy2_ns_px / n,
+                   (unsigned)(r->width * r->height * 2), "-");
+        }
+        for (int q = 0; q < quality_count; q++) {
+            if (csv) {
+                printf("%s,jpeg,%d,%.3f,%.0f,%.2f\n", size, qualities[q],
+                       r->jpeg_ns_px[q] / n, r->jpeg_bytes[q] / n, r->jpeg_psnr[q] / n);
+            } else {
+                printf("%-9s %-5s %4d %10.3f %12.0f %9.2f\n", size, "jpeg", qualities[q],
+                       r->jpeg_ns_px[q] / n, r->jpeg_bytes[q] / n, r->jpeg_psnr[q] / n);
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
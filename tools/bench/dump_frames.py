@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Record raw RGB565 frames from the device for the encoder benchmark.
+
+Talks to the firmware's UART console (the `framedump` command) while the
+UVC stream is stopped and writes frames as <out>/frame_<w>x<h>_<n>.rgb565,
+the layout encoder_bench reads.
+
+usage: dump_frames.py /dev/ttyUSB0 --size 320x240 --count 8 --out corpus
+requires: pip install pyserial
+"""
+
+import argparse
+import base64
+import os
+import sys
+
+import serial
+
+
+def read_frames(port, width, height, count, timeout):
+    port.reset_input_buffer()
+    port.write(f"framedump {width} {height} {count}\n".encode())
+
+    frames = []
+    current = None
+    while len(frames) < count:
+        line = port.readline()
+        if not line:
+            raise TimeoutError(f"no data for {timeout} s")
+        text = line.decode(errors="replace").strip()
+        if text.startswith("FRAME "):
+            _, w, h, n = text.split()
+            current = (int(w), int(h), int(n), [])
+        elif text == "END" and current is not None:
+            w, h, n, chunks = current
+            data = b"".join(chunks)
+            if len(data) == n:
+                frames.append((w, h, data))
+            else:
+                print(f"frame {len(frames)}: got {len(data)} of {n} bytes, skipped",
+                      file=sys.stderr)
+            current = None
+        elif current is not None:
+            try:
+                current[3].append(base64.b64decode(text, validate=True))
+            except ValueError:
+                pass  # Interleaved log line
+        elif text and not text.startswith("webcam>"):
+            print(text, file=sys.stderr)
+            if "stop the UVC stream" in text or "cannot configure" in text:
+                raise RuntimeError(text)
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--size", default="320x240")
+    parser.add_argument("--count", type=int, default=4)
+    parser.add_argument("--out", default="corpus")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    args = parser.parse_args()
+
+    width, height = (int(v) for v in args.size.lower().split("x"))
+    os.makedirs(args.out, exist_ok=True)
+    existing = len([f for f in os.listdir(args.out) if f.endswith(".rgb565")])
+
+    with serial.Serial(args.port, args.baud, timeout=args.timeout) as port:
+        frames = read_frames(port, width, height, args.count, args.timeout)
+
+    for i, (w, h, data) in enumerate(frames):
+        path = os.path.join(args.out, f"frame_{w}x{h}_{existing + i:03d}.rgb565")
+        with open(path, "wb") as f:
+            f.write(data)
+        print(path)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,304 @@
+/*
+ * Host regression check for the scalar jpeg_enc and color_conv kernels.
+ *
+ * Encodes fixed, generated RGB565 fixtures at several qualities (two also
+ * with a picture adjustment) and compares the length and FNV-1a hash of
+ * every JPEG against the checked-in golden.txt, so any change to the
+ * scalar bitstream shows up. Each fixture is also encoded MCU row by MCU
+ * row through jpeg_enc_begin / _encode_strip / _finish, which must give
+ * the same bytes. The same fixtures are converted to YUY2 by the scalar
+ * reference (and two by the adjusted table kernel) and checked the same
+ * way. The device checks its PIE kernels against the scalar ones with
+ * jpeg_enc_selftest() and color_conv_selftest().
+ *
+ * Built with ASan and UBSan, so an out-of-range table lookup in the
+ * adjusted kernels fails the check as well.
+ *
+ *   ./build-bench/golden_check tools/bench/golden.txt
+ *   ./build-bench/golden_check --update tools/bench/golden.txt
+ *
+ * --update rewrites the file after an intended bitstream change. Exits
+ * non-zero on the first mismatch.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_conv.h"
+#include "jpeg_enc.h"
+
+#define OUT_BYTES   (512 * 1024)
+#define MAX_CASES   32
+
+typedef enum {
+    PATTERN_FLAT = 0,
+    PATTERN_EXTREMES,
+    PATTERN_RAMP,
+    PATTERN_NOISE,
+    PATTERN_PRIMARIES,
+} pattern_t;
+
+typedef struct {
+    const char *name;
+    pattern_t pattern;
+    uint16_t width;
+    uint16_t height;
+} fixture_t;
+
+// 40 lines: the last MCU row repeats the bottom line
+static const fixture_t s_fixtures[] = {
+    { "flat", PATTERN_FLAT, 16, 16 },
+    { "extremes", PATTERN_EXTREMES, 32, 32 },
+    { "ramp", PATTERN_RAMP, 64, 40 },
+    { "noise", PATTERN_NOISE, 320, 240 },
+    { "primaries", PATTERN_PRIMARIES, 16, 16 },
+};
+
+static const uint8_t s_qualities[] = { 30, 80, 95 };
+
+// Brighter, more saturated; on the noise and primaries fixtures at q80
+static const jpeg_enc_adjust_t s_adjust = {
+    .y_gain = 160,
+    .y_offset = 10,
+    .chroma = { 150, 0, 0, 150 },
+};
+
+// The same adjustment for the YUY2 conversion
+static const color_conv_adjust_t s_yuyv_adjust = {
+    .y_gain = 160,
+    .y_offset = 10,
+    .chroma = { 150, 0, 0, 150 },
+};
+
+typedef struct {
+    char name[64];
+    size_t len;
+    uint64_t hash;
+} result_t;
+
+static result_t s_results[MAX_CASES];
+static int s_result_count = 0;
+
+static void put_pixel(uint8_t *px, int i, int r, int g, int b)
+{
+    uint16_t v = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    px[i * 2] = (uint8_t)(v >> 8);
+    px[i * 2 + 1] = (uint8_t)v;
+}
+
+static uint8_t *make_fixture(const fixture_t *f)
+{
+    int w = f->width;
+    int h = f->height;
+    uint8_t *px = aligned_alloc(16, (size_t)w * h * 2 + 16);
+    uint32_t seed = 12345;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int i = y * w + x;
+            switch (f->pattern) {
+            case PATTERN_FLAT:
+                put_pixel(px, i, 128, 128, 128);
+                break;
+            case PATTERN_EXTREMES: {
+                // Black/white 8x8 blocks next to the six primaries and secondaries
+                static const uint8_t colours[8][3] = {
+                    { 0, 0, 0 }, { 255, 255, 255 }, { 255, 0, 0 }, { 0, 255, 0 },
+                    { 0, 0, 255 }, { 255, 255, 0 }, { 0, 255, 255 }, { 255, 0, 255 },
+                };
+                const uint8_t *c = colours[((x / 8) + (y / 8) * 4) & 7];
+                put_pixel(px, i, c[0], c[1], c[2]);
+                break;
+            }
+            case PATTERN_RAMP:
+                put_pixel(px, i, (x * 255) / (w - 1), (y * 255) / (h - 1), ((x + y) * 255) / (w + h - 2));
+                break;
+            case PATTERN_NOISE:
+                seed = seed * 1664525u + 1013904223u;
+                px[i * 2] = (uint8_t)(seed >> 24);
+                px[i * 2 + 1] = (uint8_t)(seed >> 16);
+                break;
+            case PATTERN_PRIMARIES:
+                // Pure red | pure blue: the largest Cr and Cb sums
+                put_pixel(px, i, x < 8 ? 255 : 0, 0, x < 8 ? 0 : 255);
+                break;
+            }
+        }
+    }
+    return px;
+}
+
+static uint64_t fnv1a(const uint8_t *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Same frame through the incremental API, one MCU row per call
+static bool encode_by_strips(jpeg_enc_t *enc, const fixture_t *f, const uint8_t *px,
+                             uint8_t *out, size_t *out_len)
+{
+    if (!jpeg_enc_begin(enc, f->width, f->height, out, OUT_BYTES)) {
+        return false;
+    }
+    size_t stride = (size_t)f->width * 2;
+    for (int y = 0; y < f->height; y += JPEG_ENC_MCU_SIZE) {
+        int rows = f->height - y;
+        rows = rows > JPEG_ENC_MCU_SIZE ? JPEG_ENC_MCU_SIZE : rows;
+        if (!jpeg_enc_encode_strip(enc, px + (size_t)y * stride, (uint16_t)rows)) {
+            return false;
+        }
+    }
+    return jpeg_enc_finish(enc, out_len);
+}
+
+static bool run_case(jpeg_enc_t *enc, const fixture_t *f, const uint8_t *px, uint8_t quality,
+                     const jpeg_enc_adjust_t *adjust, uint8_t *out, uint8_t *out_strips)
+{
+    jpeg_enc_set_quality(enc, quality);
+    jpeg_enc_set_adjust(enc, adjust);
+
+    result_t *r = &s_results[s_result_count++];
+    snprintf(r->name, sizeof(r->name), "%s_%ux%u_q%u%s", f->name, f->width, f->height,
+             quality, adjust != NULL ? "_adjust" : "");
+
+    size_t len = 0;
+    size_t len_strips = 0;
+    if (!jpeg_enc_encode(enc, px, f->width, f->height, out, OUT_BYTES, &len)) {
+        fprintf(stderr, "%s: encode failed\n", r->name);
+        return false;
+    }
+    if (!encode_by_strips(enc, f, px, out_strips, &len_strips) ||
+        len_strips != len || memcmp(out, out_strips, len) != 0) {
+        fprintf(stderr, "%s: strip-wise encode differs from jpeg_enc_encode\n", r->name);
+        return false;
+    }
+    r->len = len;
+    r->hash = fnv1a(out, len);
+    return true;
+}
+
+// Scalar reference, or the adjusted table kernel behind the dispatcher
+static void run_yuyv_case(const fixture_t *f, const uint8_t *px,
+                          const color_conv_adjust_t *adjust, uint8_t *out)
+{
+    result_t *r = &s_results[s_result_count++];
+    snprintf(r->name, sizeof(r->name), "yuyv_%s_%ux%u%s", f->name, f->width, f->height,
+             adjust != NULL ? "_adjust" : "");
+
+    size_t pixels = (size_t)f->width * f->height;
+    if (adjust != NULL) {
+        color_conv_set_adjust(adjust);
+        color_conv_rgb565_to_yuyv(px, out, pixels);
+        color_conv_set_adjust(NULL);
+    } else {
+        color_conv_rgb565_to_yuyv_scalar(px, out, pixels);
+    }
+    r->len = pixels * 2;
+    r->hash = fnv1a(out, r->len);
+}
+
+static int write_golden(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    fprintf(f, "# Scalar jpeg_enc / color_conv output: case, bytes, FNV-1a 64 (tools/bench/golden_check.c)\n");
+    for (int i = 0; i < s_result_count; i++) {
+        fprintf(f, "%s %zu %016llx\n", s_results[i].name, s_results[i].len,
+                (unsigned long long)s_results[i].hash);
+    }
+    fclose(f);
+    printf("wrote %d cases to %s\n", s_result_count, path);
+    return 0;
+}
+
+static int check_golden(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    char line[256];
+    int matched = 0;
+    int failed = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[64];
+        size_t len = 0;
+        unsigned long long hash = 0;
+        if (line[0] == '#' || sscanf(line, "%63s %zu %llx", name, &len, &hash) != 3) {
+            continue;
+        }
+        const result_t *r = NULL;
+        for (int i = 0; i < s_result_count; i++) {
+            if (strcmp(s_results[i].name, name) == 0) {
+                r = &s_results[i];
+            }
+        }
+        if (r == NULL) {
+            fprintf(stderr, "%s: in %s but not encoded\n", name, path);
+            failed++;
+        } else if (r->len != len || r->hash != hash) {
+            fprintf(stderr, "%s: %zu B %016llx, expected %zu B %016llx\n",
+                    name, r->len, (unsigned long long)r->hash, len, hash);
+            failed++;
+        } else {
+            matched++;
+        }
+    }
+    fclose(f);
+
+    if (matched + failed != s_result_count) {
+        fprintf(stderr, "%d cases encoded, %d in %s\n", s_result_count, matched + failed, path);
+        failed++;
+    }
+    printf("%d/%d cases bit-identical to %s\n", matched, s_result_count, path);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool update = (argc > 1 && strcmp(argv[1], "--update") == 0);
+    if (argc != (update ? 3 : 2)) {
+        fprintf(stderr, "usage: %s [--update] golden_file\n", argv[0]);
+        return 2;
+    }
+    const char *path = argv[update ? 2 : 1];
+
+    static jpeg_enc_t enc;
+    jpeg_enc_init(&enc);
+    jpeg_enc_use_simd(false);
+    uint8_t *out = malloc(OUT_BYTES);
+    uint8_t *out_strips = malloc(OUT_BYTES);
+
+    for (size_t i = 0; i < sizeof(s_fixtures) / sizeof(s_fixtures[0]); i++) {
+        const fixture_t *f = &s_fixtures[i];
+        uint8_t *px = make_fixture(f);
+        for (size_t q = 0; q < sizeof(s_qualities); q++) {
+            if (!run_case(&enc, f, px, s_qualities[q], NULL, out, out_strips)) {
+                return 1;
+            }
+        }
+        if ((f->pattern == PATTERN_NOISE || f->pattern == PATTERN_PRIMARIES) &&
+            !run_case(&enc, f, px, 80, &s_adjust, out, out_strips)) {
+            return 1;
+        }
+        run_yuyv_case(f, px, NULL, out);
+        if (f->pattern == PATTERN_NOISE || f->pattern == PATTERN_PRIMARIES) {
+            run_yuyv_case(f, px, &s_yuyv_adjust, out);
+        }
+        free(px);
+    }
+    free(out);
+    free(out_strips);
+
+    return update ? write_golden(path) : check_golden(path);
+}
@@ -0,0 +1,302 @@
+/*
+ * Host check for the restart-interval band encoding used by the dual-core
+ * JPEG path on the device.
+ *
+ * Every frame is encoded once with jpeg_enc_encode() and then in bands:
+ * two bands on two threads, stitched the way the firmware does it, and a
+ * band per MCU row (more than eight, so the RSTn numbers wrap). libjpeg
+ * must decode each stitched frame without a warning and to exactly the
+ * pixels of the single-band reference, and the threaded result must match
+ * the same bands encoded one after another byte for byte.
+ *
+ * Corpus files as for encoder_bench; synthetic frames are always included.
+ *
+ *   ./build-bench/restart_check [corpus_dir]
+ *
+ * Exits non-zero on the first mismatch.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+#include "jpeg_enc.h"
+
+#define MAX_FRAMES  32
+#define MAX_BANDS   64
+#define OUT_BYTES   (1024 * 1024)
+
+typedef struct {
+    char name[256];
+    uint16_t width;
+    uint16_t height;
+    uint8_t *pixels;
+} frame_t;
+
+typedef struct {
+    jpeg_enc_t enc;
+    const frame_t *frame;
+    uint16_t first_row;     // In MCU rows
+    uint16_t rows;
+    uint8_t *buf;           // Own output buffer
+    uint8_t *out;           // Where this run encodes to
+    size_t cap;
+    size_t len;
+    bool ok;
+} band_t;
+
+static frame_t s_frames[MAX_FRAMES];
+static int s_frame_count = 0;
+static band_t s_bands[MAX_BANDS];
+
+static void load_corpus(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        fprintf(stderr, "cannot open corpus %s\n", dir);
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL && s_frame_count < MAX_FRAMES) {
+        unsigned w = 0;
+        unsigned h = 0;
+        const char *p = strchr(ent->d_name, '_');
+        if (p == NULL || sscanf(p + 1, "%ux%u", &w, &h) != 2 || w == 0 || h == 0 ||
+            (w % JPEG_ENC_MCU_SIZE) != 0) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        frame_t *fr = &s_frames[s_frame_count];
+        size_t size = (size_t)w * h * 2;
+        fr->pixels = aligned_alloc(16, size);
+        if (fread(fr->pixels, 1, size, f) == size) {
+            snprintf(fr->name, sizeof(fr->name), "%s", ent->d_name);
+            fr->width = (uint16_t)w;
+            fr->height = (uint16_t)h;
+            s_frame_count++;
+        } else {
+            free(fr->pixels);
+        }
+        fclose(f);
+    }
+    closedir(d);
+}
+
+// Gradients, hard edges and noise, as in encoder_bench
+static void synth_frame(uint16_t w, uint16_t h, uint32_t seed)
+{
+    frame_t *fr = &s_frames[s_frame_count++];
+    snprintf(fr->name, sizeof(fr->name), "synthetic_%ux%u", w, h);
+    fr->width = w;
+    fr->height = h;
+    fr->pixels = aligned_alloc(16, (size_t)w * h * 2 + 16);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            int noise = (int)(seed >> 27) - 16;
+            int r = (x * 255) / w + noise;
+            int g = (y * 255) / h + noise;
+            int b = (((x / 24) + (y / 24)) & 1) ? 230 : 20;
+            r = r < 0 ? 0 : (r > 255 ? 255 : r);
+            g = g < 0 ? 0 : (g > 255 ? 255 : g);
+            uint16_t v = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            fr->pixels[(y * w + x) * 2] = (uint8_t)(v >> 8);
+            fr->pixels[(y * w + x) * 2 + 1] = (uint8_t)v;
+        }
+    }
+}
+
+static bool encode_rows(jpeg_enc_t *enc, const frame_t *fr, uint16_t first_row, uint16_t rows)
+{
+    size_t stride = (size_t)fr->width * 2;
+    for (uint16_t i = first_row; i < first_row + rows; i++) {
+        uint16_t y = i * JPEG_ENC_MCU_SIZE;
+        uint16_t lines = (fr->height - y < JPEG_ENC_MCU_SIZE) ? fr->height - y : JPEG_ENC_MCU_SIZE;
+        if (!jpeg_enc_encode_strip(enc, fr->pixels + y * stride, lines)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void *band_worker(void *arg)
+{
+    band_t *band = (band_t *)arg;
+    band->ok = jpeg_enc_begin_band(&band->enc, band->frame->width, band->out, band->cap) &&
+               encode_rows(&band->enc, band->frame, band->first_row, band->rows) &&
+               jpeg_enc_end_band(&band->enc, &band->len);
+    return NULL;
+}
+
+/*
+ * Band 0 in place on the calling thread, the others in their own contexts
+ * (concurrently when threaded), then stitched behind band 0. Two threaded
+ * bands share the output buffer like on the device: band 1 is encoded into
+ * its back half and moved down.
+ */
+static bool encode_bands(const frame_t *fr, uint8_t quality, int bands, bool threaded,
+                         uint8_t *out, size_t *out_len)
+{
+    uint16_t band_rows = jpeg_enc_band_rows(fr->width, fr->height, bands);
+    uint16_t mcu_rows = (fr->height + JPEG_ENC_MCU_SIZE - 1) / JPEG_ENC_MCU_SIZE;
+    if (band_rows == 0) {
+        return false;
+    }
+    int count = (mcu_rows + band_rows - 1) / band_rows;
+    bool shared = threaded && count == 2;
+    size_t first_cap = shared ? OUT_BYTES / 2 : OUT_BYTES;
+
+    pthread_t threads[MAX_BANDS];
+    for (int k = 1; k < count; k++) {
+        band_t *band = &s_bands[k];
+        jpeg_enc_init(&band->enc);
+        jpeg_enc_set_quality(&band->enc, quality);
+        band->frame = fr;
+        band->first_row = (uint16_t)(k * band_rows);
+        band->rows = (mcu_rows - band->first_row < band_rows) ? mcu_rows - band->first_row : band_rows;
+        band->out = shared ? out + first_cap : band->buf;
+        band->cap = shared ? OUT_BYTES - first_cap : OUT_BYTES;
+        band->len = 0;
+        if (threaded) {
+            pthread_create(&threads[k], NULL, band_worker, band);
+        } else {
+            band_worker(band);
+        }
+    }
+
+    band_t *first = &s_bands[0];
+    jpeg_enc_init(&first->enc);
+    jpeg_enc_set_quality(&first->enc, quality);
+    bool ok = jpeg_enc_begin_restart(&first->enc, fr->width, fr->height, band_rows, out, first_cap) &&
+              encode_rows(&first->enc, fr, 0, (band_rows < mcu_rows) ? band_rows : mcu_rows);
+
+    for (int k = 1; k < count; k++) {
+        if (threaded) {
+            pthread_join(threads[k], NULL);
+        }
+        jpeg_enc_set_output_cap(&first->enc, OUT_BYTES);
+        ok = ok && s_bands[k].ok && jpeg_enc_restart(&first->enc, s_bands[k].out, s_bands[k].len);
+    }
+    return jpeg_enc_finish(&first->enc, out_len) && ok;
+}
+
+// Decode to RGB; false on error or on any libjpeg warning (e.g. a bad RSTn)
+static bool decode(const uint8_t *jpg, size_t len, uint16_t w, uint16_t h, uint8_t *rgb)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpg, (unsigned long)len);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    bool ok = (cinfo.output_width == w && cinfo.output_height == h);
+    while (ok && cinfo.output_scanline < cinfo.output_height) {
+        uint8_t *row = rgb + (size_t)cinfo.output_scanline * w * 3;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    if (ok) {
+        jpeg_finish_decompress(&cinfo);
+    }
+    ok = ok && jerr.num_warnings == 0;
+    jpeg_destroy_decompress(&cinfo);
+    return ok;
+}
+
+static bool check(const frame_t *fr, uint8_t quality, uint8_t *ref, uint8_t *seq, uint8_t *par,
+                  uint8_t *ref_rgb, uint8_t *rgb)
+{
+    static jpeg_enc_t enc;
+    size_t ref_len = 0;
+    jpeg_enc_init(&enc);
+    jpeg_enc_set_quality(&enc, quality);
+    if (!jpeg_enc_encode(&enc, fr->pixels, fr->width, fr->height, ref, OUT_BYTES, &ref_len) ||
+        !decode(ref, ref_len, fr->width, fr->height, ref_rgb)) {
+        printf("FAIL %s q%u: reference does not decode\n", fr->name, quality);
+        return false;
+    }
+    size_t rgb_size = (size_t)fr->width * fr->height * 3;
+    int mcu_rows = (fr->height + JPEG_ENC_MCU_SIZE - 1) / JPEG_ENC_MCU_SIZE;
+
+    static const int band_counts[] = { 2, 3, MAX_BANDS };
+    int last = 0;
+    for (size_t i = 0; i < sizeof(band_counts) / sizeof(band_counts[0]); i++) {
+        int bands = band_counts[i] < mcu_rows ? band_counts[i] : mcu_rows;
+        if (bands == last) {
+            continue;
+        }
+        last = bands;
+        size_t seq_len = 0;
+        size_t par_len = 0;
+        if (!encode_bands(fr, quality, bands, false, seq, &seq_len) ||
+            !encode_bands(fr, quality, bands, true, par, &par_len)) {
+            printf("FAIL %s q%u %d bands: encode failed\n", fr->name, quality, bands);
+            return false;
+        }
+        if (par_len != seq_len || memcmp(par, seq, seq_len) != 0) {
+            printf("FAIL %s q%u %d bands: threaded bitstream differs\n", fr->name, quality, bands);
+            return false;
+        }
+        if (!decode(par, par_len, fr->width, fr->height, rgb)) {
+            printf("FAIL %s q%u %d bands: libjpeg decode error or warning\n", fr->name, quality, bands);
+            return false;
+        }
+        if (memcmp(rgb, ref_rgb, rgb_size) != 0) {
+            printf("FAIL %s q%u %d bands: decoded pixels differ\n", fr->name, quality, bands);
+            return false;
+        }
+        printf("ok   %-32s q%-3u %2d bands  %6zu B (+%zu)\n", fr->name, quality, bands,
+               par_len, par_len - ref_len);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        load_corpus(argv[1]);
+    }
+    synth_frame(320, 240, 1);
+    synth_frame(640, 480, 2);
+    synth_frame(160, 120, 3);
+    synth_frame(48, 7, 4);      // Single partial MCU row
+    synth_frame(32, 40, 5);     // Partial last band
+
+    // Band 0 is encoded into the frame buffer itself
+    for (int k = 1; k < MAX_BANDS; k++) {
+        s_bands[k].buf = malloc(OUT_BYTES);
+    }
+    uint8_t *ref = malloc(OUT_BYTES);
+    uint8_t *seq = malloc(OUT_BYTES);
+    uint8_t *par = malloc(OUT_BYTES);
+    uint8_t *ref_rgb = NULL;
+    uint8_t *rgb = NULL;
+
+    static const uint8_t qualities[] = { 30, 80, 95 };
+    for (int f = 0; f < s_frame_count; f++) {
+        const frame_t *fr = &s_frames[f];
+        size_t rgb_size = (size_t)fr->width * fr->height * 3;
+        ref_rgb = realloc(ref_rgb, rgb_size);
+        rgb = realloc(rgb, rgb_size);
+        for (size_t q = 0; q < sizeof(qualities); q++) {
+            if (!check(fr, qualities[q], ref, seq, par, ref_rgb, rgb)) {
+                return 1;
+            }
+        }
+    }
+    printf("all %d frames decode identically\n", s_frame_count);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Poll the device's telemetry Extension Unit over UVC (Linux).
+
+Reads every control of extension unit 4 with UVCIOC_CTRL_QUERY / GET_CUR,
+the same request uvcdynctrl sends, so no serial console is needed.
+
+usage: uvc_telemetry.py /dev/video2 [--interval 5]
+"""
+
+import argparse
+import ctypes
+import fcntl
+import os
+import sys
+import time
+
+UNIT_ID = 4
+UVC_GET_CUR = 0x81
+
+# Selector -> (name, scale, unit); mirrors main/include/uvc_telemetry.h
+CONTROLS = {
+    1: ("fps", 10, ""),
+    2: ("encode avg", 1, "us"),
+    3: ("encode max", 1, "us"),
+    4: ("frame avg", 1, "B"),
+    5: ("dropped", 1, ""),
+    6: ("free internal", 1, "B"),
+    7: ("free psram", 1, "B"),
+    8: ("cpu0", 10, "%"),
+    9: ("cpu1", 10, "%"),
+}
+
+
+class UvcXuControlQuery(ctypes.Structure):
+    _fields_ = [
+        ("unit", ctypes.c_uint8),
+        ("selector", ctypes.c_uint8),
+        ("query", ctypes.c_uint8),
+        ("size", ctypes.c_uint16),
+        ("data", ctypes.POINTER(ctypes.c_uint8)),
+    ]
+
+
+def _iowr(type_, nr, size):
+    return (3 << 30) | (size << 16) | (ord(type_) << 8) | nr
+
+
+UVCIOC_CTRL_QUERY = _iowr("u", 0x21, ctypes.sizeof(UvcXuControlQuery))
+
+
+def get_cur(fd, selector):
+    buf = (ctypes.c_uint8 * 4)()
+    query = UvcXuControlQuery(UNIT_ID, selector, UVC_GET_CUR, 4, buf)
+    fcntl.ioctl(fd, UVCIOC_CTRL_QUERY, query)
+    return int.from_bytes(bytes(buf), "little")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("device", help="video node, e.g. /dev/video2")
+    parser.add_argument("--interval", type=float, default=0,
+                        help="repeat every N seconds (default: once)")
+    args = parser.parse_args()
+
+    fd = os.open(args.device, os.O_RDWR)
+    try:
+        while True:
+            fields = []
+            for selector, (name, scale, unit) in CONTROLS.items():
+                value = get_cur(fd, selector)
+                text = f"{value / scale:.1f}" if scale != 1 else str(value)
+                fields.append(f"{name} {text}{unit}")
+            print(" | ".join(fields), flush=True)
+            if args.interval <= 0:
+                return 0
+            time.sleep(args.interval)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""Device-side latency and jitter from the UVC payload header PTS / SCR.
+
+Linux uvcvideo exposes each frame's payload header on the metadata node
+that follows the video node (V4L2_META_FMT_UVC). Record it while the
+stream runs, e.g. with the video on /dev/video2:
+
+    ffplay -f v4l2 -input_format mjpeg -video_size 320x240 /dev/video2 &
+    v4l2-ctl -d /dev/video3 --stream-mmap --stream-count=300 --stream-to=meta.bin
+    uvc_timing.py meta.bin
+
+Each record is struct uvc_meta_buf: u64 host ns, u16 host SOF, u8 header
+length, u8 bmHeaderInfo, then the rest of the header (PTS u32, SCR u32 STC
++ u16 SOF). PTS and STC count at the device clock (UVC_CLOCK_FREQUENCY).
+
+Reported per frame:
+  capture->queue  device time from sensor capture (PTS) to the first packet
+                  being queued (SCR STC)
+  queue->host     USB frames between the device queueing the first packet
+                  and the host receiving it (device vs. host SOF, ~1 ms each)
+  interval        PTS difference to the previous frame; its spread is the
+                  capture jitter
+"""
+
+import argparse
+import statistics
+import struct
+import sys
+
+HDR_PTS = 1 << 2
+HDR_SCR = 1 << 3
+META_FIXED = struct.Struct("<QHBB")
+
+
+def read_records(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    records = []
+    pos = 0
+    while pos + META_FIXED.size <= len(data):
+        ns, host_sof, length, flags = META_FIXED.unpack_from(data, pos)
+        body = data[pos + META_FIXED.size:pos + META_FIXED.size + max(length - 2, 0)]
+        pos += META_FIXED.size + max(length - 2, 0)
+        if length < 2 or len(body) < length - 2:
+            break
+        if (flags & (HDR_PTS | HDR_SCR)) != (HDR_PTS | HDR_SCR) or len(body) < 10:
+            continue
+        pts, stc, dev_sof = struct.unpack_from("<IIH", body)
+        records.append((ns, host_sof & 0x7FF, pts, stc, dev_sof & 0x7FF))
+    return records
+
+
+def frames(records):
+    # One entry per frame: the first header carrying a new PTS
+    out = []
+    last_pts = None
+    for rec in records:
+        if rec[2] != last_pts:
+            out.append(rec)
+            last_pts = rec[2]
+    return out
+
+
+def describe(name, values, unit):
+    if not values:
+        print(f"{name:16s} -")
+        return
+    ordered = sorted(values)
+    p50 = ordered[(len(ordered) - 1) // 2]
+    p99 = ordered[((len(ordered) - 1) * 99) // 100]
+    print(f"{name:16s} p50 {p50:9.2f}  p99 {p99:9.2f}  max {ordered[-1]:9.2f}  "
+          f"jitter {p99 - p50:8.2f} {unit}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("meta", help="metadata captured from the uvcvideo meta node")
+    parser.add_argument("--clock", type=int, default=27000000,
+                        help="device clock in Hz (UVC_CLOCK_FREQUENCY, default %(default)s)")
+    args = parser.parse_args()
+
+    recs = frames(read_records(args.meta))
+    if len(recs) < 2:
+        print("no frames with PTS and SCR found", file=sys.stderr)
+        return 1
+
+    to_ms = 1000.0 / args.clock
+    capture_to_queue = [((stc - pts) & 0xFFFFFFFF) * to_ms for _, _, pts, stc, _ in recs]
+    queue_to_host = [float((host_sof - dev_sof) & 0x7FF) for _, host_sof, _, _, dev_sof in recs]
+    intervals = [((b[2] - a[2]) & 0xFFFFFFFF) * to_ms for a, b in zip(recs, recs[1:])]
+    arrivals = [(b[0] - a[0]) / 1e6 for a, b in zip(recs, recs[1:])]
+
+    print(f"frames {len(recs)}, {1000.0 / statistics.mean(intervals):.1f} fps by PTS")
+    describe("capture->queue", capture_to_queue, "ms")
+    describe("queue->host", queue_to_host, "ms (USB frames)")
+    describe("interval", intervals, "ms")
+    describe("host arrival", arrivals, "ms")
+    total = [a + b for a, b in zip(capture_to_queue, queue_to_host)]
+    describe("capture->host", total, "ms")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())